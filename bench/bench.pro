@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# cutecom-ng benchmark tool
+#
+# build it separately: qmake bench/bench.pro && make
+#
+#-------------------------------------------------
+
+TARGET = cutecom-ng-bench
+TEMPLATE = app
+DESTDIR = bin
+
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .generated/
+MOC_DIR = .generated/
+RCC_DIR = .generated/
+UI_DIR = .generated/
+
+include(../cutecom-ng.pri)
+
+!unix: error("cutecom-ng-bench needs pseudo-terminals, it only builds on unix")
+unix:!macx: LIBS += -lutil
+
+SOURCES += main.cpp \
+    microbench.cpp \
+    transferbench.cpp
+
+HEADERS += microbench.h \
+    transferbench.h
@@ -0,0 +1,426 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief cutecom-ng end-to-end throughput benchmark
+ *
+ * synthetic traffic is written to the master side of a pseudo-terminal
+ * pair, while a real cutecom-ng main window has a session opened on the
+ * slave side. Every chunk starts with a header line carrying a sequence
+ * number and its sending time, which are checked once the chunk made it
+ * through SessionManager and OutputManager. The output view is updated from
+ * the same thread, so its cost is part of the measured throughput.
+ *
+ * results are printed as JSON on stdout, run it offscreen with:
+ *
+ *     QT_QPA_PLATFORM=offscreen cutecom-ng-bench --rate 1000000
+ *
+ * --micro runs a micro-benchmark of a single stage instead, --xmodem an
+ * XModem upload over a pseudo-terminal pair, --zmodem a ZModem upload to
+ * lrzsz rz.
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "mainwindow.h"
+#include "sessionmanager.h"
+#include "outputmanager.h"
+#include "connectdialog.h"
+#include "chunkring.h"
+#include "microbench.h"
+#include "transferbench.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QTimer>
+#include <QFile>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef Q_OS_MAC
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+/// size of the header line starting every chunk: "#<seq>:<timestamp>\n"
+const int CHUNK_HEADER_SIZE = 1 + 10 + 1 + 19 + 1;
+
+/// length of filler lines following the header
+const int FILLER_LINE_LENGTH = 64;
+
+/// give up waiting for the pipeline after this much time without progress
+const int DRAIN_TIMEOUT_MS = 10000;
+
+/**
+ * \brief benchmark settings
+ */
+struct BenchConfig
+{
+    /// bytes per second written to the pty, 0 for unlimited
+    qint64  rate;
+
+    /// size of each chunk written to the pty
+    int     chunk_size;
+
+    /// traffic generation duration, in seconds
+    double  duration;
+
+    /// dump file, empty if dump is disabled
+    QString dump_file;
+
+    /// dump file format
+    ConnectDialog::DumpFormat dump_format;
+};
+
+/**
+ * \brief write chunks to the pty master at a given rate
+ */
+class TrafficGenerator : public QThread
+{
+private:
+    int                 fd;
+    const BenchConfig  &cfg;
+
+public:
+    std::atomic<qint64> bytes_sent;
+    std::atomic<qint64> chunks_sent;
+    qint64              start_ns;
+
+    TrafficGenerator(int fd, const BenchConfig &cfg) :
+        fd(fd), cfg(cfg), bytes_sent(0), chunks_sent(0), start_ns(0)
+    {
+    }
+
+protected:
+    void run()
+    {
+        // filler made of fixed-length lines, chunk always ends with '\n'
+        QByteArray chunk(cfg.chunk_size, 'x');
+        for (int i = CHUNK_HEADER_SIZE + FILLER_LINE_LENGTH - 1; i < chunk.size(); i += FILLER_LINE_LENGTH)
+            chunk[i] = '\n';
+        chunk[chunk.size() - 1] = '\n';
+
+        start_ns = ChunkRing::timestamp();
+        const qint64 end_ns = start_ns + cfg.duration * 1e9;
+
+        qint64 now;
+        while ((now = ChunkRing::timestamp()) < end_ns)
+        {
+            if (cfg.rate > 0)
+            {
+                const qint64 due_ns = start_ns + bytes_sent * 1e9 / cfg.rate;
+                if (due_ns > now)
+                    QThread::usleep((due_ns - now) / 1000);
+            }
+
+            char header[CHUNK_HEADER_SIZE + 1];
+            qsnprintf(header, sizeof(header), "#%010lld:%019lld\n",
+                      (long long)chunks_sent.load(), (long long)ChunkRing::timestamp());
+            memcpy(chunk.data(), header, CHUNK_HEADER_SIZE);
+
+            const char *p = chunk.constData();
+            qint64 left = chunk.size();
+            while (left > 0)
+            {
+                const ssize_t written = ::write(fd, p, left);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return;
+                }
+                p += written;
+                left -= written;
+            }
+
+            bytes_sent += chunk.size();
+            ++chunks_sent;
+        }
+    }
+};
+
+/**
+ * \brief check chunks coming out of the pipeline
+ */
+struct TrafficChecker
+{
+    QByteArray          carry;
+    qint64              bytes_received;
+    qint64              chunks_received;
+    qint64              chunks_missing;
+    qint64              next_seq;
+    qint64              last_receive_ns;
+    std::vector<qint64> latencies_ns;
+
+    TrafficChecker() :
+        bytes_received(0), chunks_received(0), chunks_missing(0),
+        next_seq(0), last_receive_ns(0)
+    {
+    }
+
+    void handleData(const QByteArray &data)
+    {
+        const qint64 now = ChunkRing::timestamp();
+        bytes_received += data.size();
+        last_receive_ns = now;
+
+        carry.append(data);
+
+        int pos = 0, nl;
+        while ((nl = carry.indexOf('\n', pos)) >= 0)
+        {
+            if (carry.at(pos) == '#' && nl - pos == CHUNK_HEADER_SIZE - 1)
+            {
+                const qint64 seq = carry.mid(pos + 1, 10).toLongLong();
+                const qint64 sent_ns = carry.mid(pos + 12, 19).toLongLong();
+
+                if (seq > next_seq)
+                    chunks_missing += seq - next_seq;
+                next_seq = seq + 1;
+
+                ++chunks_received;
+                latencies_ns.push_back(now - sent_ns);
+            }
+            pos = nl + 1;
+        }
+        carry.remove(0, pos);
+    }
+
+    QJsonObject latencies()
+    {
+        QJsonObject result;
+        if (latencies_ns.empty())
+            return result;
+
+        std::sort(latencies_ns.begin(), latencies_ns.end());
+        const size_t n = latencies_ns.size();
+        const double percentiles[] = { 50, 90, 99, 99.9 };
+        const char *names[] = { "p50", "p90", "p99", "p99_9" };
+
+        result["min"] = latencies_ns.front() / 1000.0;
+        for (int i = 0; i < 4; ++i)
+            result[names[i]] = latencies_ns[qMin<size_t>(n - 1, n * percentiles[i] / 100)] / 1000.0;
+        result["max"] = latencies_ns.back() / 1000.0;
+        return result;
+    }
+};
+
+/**
+ * \brief print results on stdout and optionally write them to a file
+ */
+static void writeResults(const QJsonObject &results, const QString &filename)
+{
+    const QByteArray json = QJsonDocument(results).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+
+    if (!filename.isEmpty())
+    {
+        QFile output(filename);
+        if (output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            output.write(json);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("cutecom-ng end-to-end throughput benchmark");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("rate", "bytes per second, 0 for unlimited", "bytes", "0"));
+    parser.addOption(QCommandLineOption("chunk", "chunk size in bytes", "bytes", "4096"));
+    parser.addOption(QCommandLineOption("duration", "traffic duration in seconds", "seconds", "10"));
+    parser.addOption(QCommandLineOption("dump", "also dump received data to file", "file"));
+    parser.addOption(QCommandLineOption("dump-format", "raw, text or capture", "format", "raw"));
+    parser.addOption(QCommandLineOption("refresh", "maximum refresh rate of the views, in Hz", "hz"));
+    parser.addOption(QCommandLineOption("output", "also write results to file", "file"));
+    parser.addOption(QCommandLineOption("micro", "run a micro-benchmark instead: decoder, lineindex, triggers or crc", "name"));
+    parser.addOption(QCommandLineOption("xmodem", "run an XModem upload benchmark instead", "kib"));
+    parser.addOption(QCommandLineOption("ports", "number of concurrent XModem uploads", "count", "1"));
+    parser.addOption(QCommandLineOption("zmodem", "run a ZModem upload and resume benchmark against rz instead", "kib"));
+    parser.addOption(QCommandLineOption("window", "ZModem window, in KiB, 0 for none", "kib", "0"));
+    parser.process(app);
+
+    if (parser.isSet("xmodem"))
+    {
+        QJsonObject results;
+        results["xmodem"] = benchmarkXModem(parser.value("xmodem").toInt() * 1024,
+                                             qMax(1, parser.value("ports").toInt()));
+        writeResults(results, parser.value("output"));
+        return 0;
+    }
+
+    if (parser.isSet("zmodem"))
+    {
+        QJsonObject results;
+        results["zmodem"] = benchmarkZModem(parser.value("zmodem").toInt() * 1024,
+                                             parser.value("window").toInt() * 1024);
+        writeResults(results, parser.value("output"));
+        return results["zmodem"].toObject()["verified"].toBool() ? 0 : 1;
+    }
+
+    if (parser.isSet("micro"))
+    {
+        QJsonObject results;
+        if (parser.value("micro") == "decoder")
+            results["decoder"] = benchmarkDecoder(parser.value("chunk").toInt());
+        else if (parser.value("micro") == "lineindex")
+            results["lineindex"] = benchmarkLineIndex(parser.value("chunk").toInt());
+        else if (parser.value("micro") == "triggers")
+            results["triggers"] = benchmarkTriggers(parser.value("chunk").toInt());
+        else if (parser.value("micro") == "crc")
+            results["crc"] = benchmarkCrc(parser.value("chunk").toInt());
+        else
+        {
+            qCritical("unknown micro-benchmark %s", qPrintable(parser.value("micro")));
+            return 1;
+        }
+
+        results["chunk_size"] = parser.value("chunk").toInt();
+        writeResults(results, parser.value("output"));
+
+        // a CRC implementation disagreeing with the reference is a failure
+        if (results.contains("crc") && !results["crc"].toObject()["verified"].toBool())
+            return 1;
+        return 0;
+    }
+
+    BenchConfig cfg;
+    cfg.rate = parser.value("rate").toLongLong();
+    cfg.chunk_size = qMax(parser.value("chunk").toInt(), CHUNK_HEADER_SIZE + 1);
+    cfg.duration = parser.value("duration").toDouble();
+    cfg.dump_file = parser.value("dump");
+    cfg.dump_format = ConnectDialog::Raw;
+    if (parser.value("dump-format") == "text")
+        cfg.dump_format = ConnectDialog::Ascii;
+    else if (parser.value("dump-format") == "capture")
+        cfg.dump_format = ConnectDialog::Capture;
+
+    // pseudo-terminal pair, slave side in raw mode
+    int master_fd, slave_fd;
+    char slave_name[256];
+    if (openpty(&master_fd, &slave_fd, slave_name, 0, 0) < 0)
+    {
+        qCritical("openpty failed: %s", strerror(errno));
+        return 1;
+    }
+
+    struct termios tio;
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+
+    MainWindow window;
+    window.show();
+
+    SessionManager *session_mgr = window.findChild<SessionManager*>();
+    OutputManager *output_mgr = window.findChild<OutputManager*>();
+    Q_ASSERT(session_mgr && output_mgr);
+
+    if (parser.isSet("refresh"))
+        window.setMaxRefreshRate(parser.value("refresh").toInt());
+
+    // connected after the main window, so data has been stored and the view
+    // refresh scheduled when called
+    TrafficChecker checker;
+    QObject::connect(output_mgr, &OutputManager::dataAdded,
+                     [&checker](const QByteArray &data) { checker.handleData(data); });
+
+    QHash<QString, QString> port_cfg;
+    port_cfg["device"] = QString::fromLocal8Bit(slave_name);
+    port_cfg["baud_rate"] = QString::number(QSerialPort::Baud115200);
+    port_cfg["data_bits"] = QString::number(QSerialPort::Data8);
+    port_cfg["parity"] = QString::number(QSerialPort::NoParity);
+    port_cfg["stop_bits"] = QString::number(QSerialPort::OneStop);
+    port_cfg["flow_control"] = QString::number(QSerialPort::NoFlowControl);
+    port_cfg["dump_enabled"] = cfg.dump_file.isEmpty() ? "0" : "1";
+    port_cfg["dump_file"] = cfg.dump_file;
+    port_cfg["dump_format"] = QString::number(cfg.dump_format);
+    port_cfg["dump_sync"] = QString::number(DumpWriter::NoSync);
+
+    session_mgr->openSession(port_cfg);
+    if (!session_mgr->isSessionOpen())
+    {
+        qCritical("can't open %s", slave_name);
+        return 1;
+    }
+
+    TrafficGenerator generator(master_fd, cfg);
+
+    // once generator is done, wait for the pipeline to deliver everything
+    QTimer drain_timer;
+    qint64 last_progress_ns = 0, last_bytes = -1;
+    QObject::connect(&generator, &QThread::finished, [&]() {
+        last_progress_ns = ChunkRing::timestamp();
+        drain_timer.start(20);
+    });
+    QObject::connect(&drain_timer, &QTimer::timeout, [&]() {
+        const qint64 now = ChunkRing::timestamp();
+        if (checker.bytes_received != last_bytes)
+        {
+            last_bytes = checker.bytes_received;
+            last_progress_ns = now;
+        }
+        if (checker.bytes_received >= generator.bytes_sent ||
+                now - last_progress_ns > DRAIN_TIMEOUT_MS * Q_INT64_C(1000000))
+            app.quit();
+    });
+
+    generator.start();
+    app.exec();
+    generator.wait();
+
+    session_mgr->closeSession();
+    ::close(master_fd);
+    ::close(slave_fd);
+
+    // results
+    const double seconds = qMax<qint64>(checker.last_receive_ns - generator.start_ns, 1) / 1e9;
+
+    QJsonObject config;
+    config["rate"] = cfg.rate;
+    config["chunk_size"] = cfg.chunk_size;
+    config["duration"] = cfg.duration;
+    config["refresh"] = parser.isSet("refresh") ? parser.value("refresh").toInt() : -1;
+    config["dump_format"] = cfg.dump_file.isEmpty() ? QString("none") : parser.value("dump-format");
+
+    QJsonObject results;
+    results["config"] = config;
+    results["bytes_sent"] = (double)generator.bytes_sent;
+    results["bytes_received"] = (double)checker.bytes_received;
+    results["bytes_dropped"] = (double)(generator.bytes_sent - checker.bytes_received);
+    results["chunks_sent"] = (double)generator.chunks_sent;
+    results["chunks_received"] = (double)checker.chunks_received;
+    results["chunks_missing"] = (double)(checker.chunks_missing + generator.chunks_sent - checker.next_seq);
+    results["seconds"] = seconds;
+    results["throughput_bytes_per_s"] = checker.bytes_received / seconds;
+    results["latency_us"] = checker.latencies();
+
+    if (!cfg.dump_file.isEmpty())
+    {
+        const DumpWriter::Statistics stats = session_mgr->dumpStatistics();
+        QJsonObject dump;
+        dump["bytes_written"] = (double)stats.bytes_written;
+        dump["flush_count"] = (double)stats.flush_count;
+        dump["max_flush_us"] = (double)stats.max_flush_usecs;
+        dump["mean_flush_us"] = stats.flush_count ? (double)stats.total_flush_usecs / stats.flush_count : 0.0;
+        results["dump"] = dump;
+    }
+
+    writeResults(results, parser.value("output"));
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief cutecom-ng micro-benchmarks
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "microbench.h"
+#include "textdecoder.h"
+#include "lineindex.h"
+#include "triggerengine.h"
+#include "crc16.h"
+#include "crc32.h"
+#include "crcclmul.h"
+
+#include <QElapsedTimer>
+
+/// amount of data processed by each measure
+const int MICROBENCH_DATA_SIZE = 64 * 1024 * 1024;
+
+/**
+ * \brief build a buffer of text lines
+ * \param size      buffer size
+ * \param special   UTF-8 sequence inserted once per line, may be empty
+ */
+static QByteArray makeTraffic(int size, const QByteArray &special)
+{
+    const QByteArray line = QByteArray("temperature=21.5 humidity=40% ") + special + "status=ok\r\n";
+
+    QByteArray traffic;
+    traffic.reserve(size + line.size());
+    while (traffic.size() < size)
+        traffic.append(line);
+    traffic.truncate(size);
+    return traffic;
+}
+
+/**
+ * \brief return throughput in MB/s of a per-chunk conversion
+ */
+template <typename Convert>
+static double measure(const QByteArray &traffic, int chunk_size, Convert convert)
+{
+    qint64 checksum = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int pos = 0; pos < traffic.size(); pos += chunk_size)
+    {
+        const QByteArray chunk = QByteArray::fromRawData(traffic.constData() + pos,
+                                                         qMin(chunk_size, traffic.size() - pos));
+        checksum += convert(chunk).size();
+    }
+    const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+    // keep the conversion from being optimized away
+    if (checksum < 0)
+        qWarning("unexpected checksum");
+
+    return traffic.size() * 1e3 / nsecs;
+}
+
+QJsonObject benchmarkDecoder(int chunk_size)
+{
+    chunk_size = qMax(chunk_size, 1);
+
+    struct
+    {
+        const char  *name;
+        QByteArray  special;
+    } kinds[] = {
+        { "ascii", QByteArray() },
+        { "utf8", QByteArray("\xc2\xb0\x43 \xe2\x86\x92 ") },
+    };
+
+    QJsonObject result;
+    for (const auto &kind : kinds)
+    {
+        const QByteArray traffic = makeTraffic(MICROBENCH_DATA_SIZE, kind.special);
+
+        TextDecoder decoder;
+        QJsonObject measures;
+        measures["qstring_mb_per_s"] = measure(traffic, chunk_size,
+            [](const QByteArray &chunk) { return QString(chunk); });
+        measures["decoder_mb_per_s"] = measure(traffic, chunk_size,
+            [&decoder](const QByteArray &chunk) { return decoder.decode(chunk); });
+        result[kind.name] = measures;
+    }
+
+    return result;
+}
+
+QJsonObject benchmarkLineIndex(int chunk_size)
+{
+    chunk_size = qMax(chunk_size, 1);
+
+    const QByteArray traffic = makeTraffic(MICROBENCH_DATA_SIZE, QByteArray());
+
+    LineIndex index;
+    QJsonObject measures;
+    measures["bytewise_mb_per_s"] = measure(traffic, chunk_size, [](const QByteArray &chunk) {
+        // same line ends as LineIndex, ignoring CR+LF split between chunks
+        QVector<qint64> starts;
+        const char *data = chunk.constData();
+        for (int i = 0; i < chunk.size(); ++i)
+        {
+            if (data[i] == '\r' || (data[i] == '\n' && (i == 0 || data[i - 1] != '\r')))
+                starts.append(i + 1);
+        }
+        return starts;
+    });
+    measures["lineindex_mb_per_s"] = measure(traffic, chunk_size, [&index](const QByteArray &chunk) {
+        index.append(chunk.constData(), chunk.size());
+        return chunk;
+    });
+    measures["lines"] = (double)index.lineCount();
+
+    return measures;
+}
+
+QJsonObject benchmarkTriggers(int chunk_size)
+{
+    chunk_size = qMax(chunk_size, 1);
+
+    const QByteArray traffic = makeTraffic(MICROBENCH_DATA_SIZE, QByteArray());
+
+    // patterns sharing prefixes with the traffic, none of them matching
+    QVector<TriggerEngine::Trigger> triggers;
+    for (int i = 0; i < 64; ++i)
+    {
+        TriggerEngine::Trigger trigger;
+        trigger.pattern = "status=error" + QByteArray::number(i);
+        trigger.regex = false;
+        trigger.action = TriggerEngine::Mark;
+        triggers.append(trigger);
+    }
+
+    QJsonObject measures;
+    TriggerEngine engine;
+    QVector<TriggerEngine::Match> matches;
+    auto scan = [&engine, &matches](const QByteArray &chunk) {
+        matches.clear();
+        engine.scan(chunk.constData(), chunk.size(), &matches);
+        return chunk;
+    };
+
+    engine.setTriggers(triggers);
+    measures["literals_mb_per_s"] = measure(traffic, chunk_size, scan);
+
+    TriggerEngine::Trigger regex_trigger;
+    regex_trigger.pattern = "humidity=9\\d%";
+    regex_trigger.regex = true;
+    regex_trigger.action = TriggerEngine::Mark;
+    triggers.append(regex_trigger);
+
+    engine.setTriggers(triggers);
+    measures["literals_regex_mb_per_s"] = measure(traffic, chunk_size, scan);
+
+    // longest chunk scan
+    qint64 max_nsecs = 0;
+    QElapsedTimer timer;
+    for (int pos = 0; pos < traffic.size(); pos += chunk_size)
+    {
+        timer.start();
+        matches.clear();
+        engine.scan(traffic.constData() + pos, qMin(chunk_size, traffic.size() - pos), &matches);
+        max_nsecs = qMax(max_nsecs, timer.nsecsElapsed());
+    }
+    measures["max_chunk_scan_usecs"] = max_nsecs / 1e3;
+
+    return measures;
+}
+
+/**
+ * \brief check that impl matches the reference for all lengths up to a few
+ *  blocks, at all alignments, and when fed in two parts
+ */
+template <typename Crc>
+static bool crossCheck(const QByteArray &data, Crc reference, Crc impl)
+{
+    const char *base = data.constData();
+    for (int align = 0; align < 16; ++align)
+    {
+        for (int len = 0; len <= 1100; ++len)
+        {
+            const char *buf = base + align;
+            const auto expected = reference(0x5a5a, buf, len);
+            if (impl(0x5a5a, buf, len) != expected)
+                return false;
+
+            const int split = len / 3;
+            if (impl(impl(0x5a5a, buf, split), buf + split, len - split) != expected)
+                return false;
+        }
+    }
+    return true;
+}
+
+QJsonObject benchmarkCrc(int chunk_size)
+{
+    chunk_size = qMax(chunk_size, 1);
+
+    // pseudo-random data, so that all table entries get exercised
+    QByteArray data(MICROBENCH_DATA_SIZE, Qt::Uninitialized);
+    quint32 seed = 0x12345678;
+    for (int i = 0; i < data.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = char(seed >> 24);
+    }
+
+    struct Impl16
+    {
+        const char      *name;
+        unsigned short  (*crc)(unsigned short, const void *, int);
+    } impls16[] = {
+        { "crc16_bytewise_mb_per_s", crc16_ccitt_bytewise },
+        { "crc16_slice8_mb_per_s", crc16_ccitt_slice8 },
+        { "crc16_clmul_mb_per_s", crc16_ccitt_clmul },
+        { "crc16_mb_per_s", crc16_ccitt_update },
+    };
+
+    struct Impl32
+    {
+        const char      *name;
+        unsigned int    (*crc)(unsigned int, const void *, int);
+    } impls32[] = {
+        { "crc32_bytewise_mb_per_s", crc32_bytewise },
+        { "crc32_slice8_mb_per_s", crc32_slice8 },
+        { "crc32_clmul_mb_per_s", crc32_clmul },
+        { "crc32_mb_per_s", crc32_update },
+    };
+
+    QJsonObject measures;
+    bool verified = true;
+
+    for (const auto &impl : impls16)
+    {
+        verified = verified && crossCheck(data, crc16_ccitt_bytewise, impl.crc);
+
+        unsigned short crc = 0;
+        measures[impl.name] = measure(data, chunk_size, [&crc, &impl](const QByteArray &chunk) {
+            crc = impl.crc(crc, chunk.constData(), chunk.size());
+            return chunk;
+        });
+    }
+
+    for (const auto &impl : impls32)
+    {
+        verified = verified && crossCheck(data, crc32_bytewise, impl.crc);
+
+        unsigned int crc = 0;
+        measures[impl.name] = measure(data, chunk_size, [&crc, &impl](const QByteArray &chunk) {
+            crc = impl.crc(crc, chunk.constData(), chunk.size());
+            return chunk;
+        });
+    }
+
+    // CRC-32 check value
+    verified = verified && crc32_update(0, "123456789", 9) == 0xcbf43926;
+
+    measures["clmul_available"] = crc_clmul_available() != 0;
+    measures["verified"] = verified;
+    return measures;
+}
@@ -0,0 +1,47 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief cutecom-ng micro-benchmarks
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <QJsonObject>
+
+/**
+ * \brief compare TextDecoder against a plain QString conversion of each chunk
+ * \param chunk_size size of decoded chunks
+ * \return throughput of each method on several kinds of traffic
+ */
+QJsonObject benchmarkDecoder(int chunk_size);
+
+/**
+ * \brief compare LineIndex against a byte at a time line break scan
+ * \param chunk_size size of indexed chunks
+ * \return throughput of each method
+ */
+QJsonObject benchmarkLineIndex(int chunk_size);
+
+/**
+ * \brief measure TriggerEngine scan with many literal patterns and a regex
+ * \param chunk_size size of scanned chunks
+ * \return throughput, and longest scan of a chunk which bounds the time
+ *  between an occurence and its action
+ */
+QJsonObject benchmarkTriggers(int chunk_size);
+
+/**
+ * \brief cross-check the CRC-16 and CRC-32 implementations against the byte
+ *  at a time reference, then measure each of them
+ * \param chunk_size size of the buffers checksummed at once
+ * \return throughput of each implementation, and whether they all agree
+ */
+QJsonObject benchmarkCrc(int chunk_size);
+
+#endif // MICROBENCH_H
@@ -0,0 +1,465 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief cutecom-ng file transfer benchmark
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "transferbench.h"
+#include "xmodemtransfer.h"
+#include "zmodemtransfer.h"
+#include "crc16.h"
+
+#include <QtSerialPort>
+#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QThread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef Q_OS_MAC
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+/// xmodem control chars
+const char XMODEM_SOH = 0x01;
+const char XMODEM_STX = 0x02;
+const char XMODEM_EOT = 0x04;
+const char XMODEM_ACK = 0x06;
+const char XMODEM_NAK = 0x15;
+const char XMODEM_CAN = 0x18;
+
+/// receiver gives up after this much time without data
+const int RECEIVE_TIMEOUT_MS = 5000;
+
+/**
+ * \brief minimal XModem-CRC receiver on a pty master
+ *
+ * reads are buffered, so that the receiver is never the bottleneck
+ */
+class XModemReceiver : public QThread
+{
+private:
+    int         fd;
+    QByteArray  pending;
+
+public:
+    QByteArray  data;
+    qint64      packets;
+    qint64      naks;
+    bool        completed;
+
+    explicit XModemReceiver(int fd) :
+        fd(fd), packets(0), naks(0), completed(false)
+    {
+    }
+
+protected:
+    void run()
+    {
+        unsigned char expected = 1;
+        send(QByteArray(1, 'C'));
+
+        QByteArray header;
+        while (read(1, &header))
+        {
+            int size;
+            switch (header.at(0))
+            {
+                case XMODEM_EOT:
+                    send(QByteArray(1, XMODEM_ACK));
+                    completed = true;
+                    return;
+                case XMODEM_CAN:
+                    return;
+                case XMODEM_SOH:
+                    size = 128;
+                    break;
+                case XMODEM_STX:
+                    size = 1024;
+                    break;
+                default:
+                    continue;
+            }
+
+            // block number, its complement, data and CRC
+            QByteArray packet;
+            if (!read(2 + size + 2, &packet))
+                return;
+
+            const uchar *p = reinterpret_cast<const uchar *>(packet.constData());
+            const unsigned short crc = (p[2 + size] << 8) | p[2 + size + 1];
+            if (p[0] != uchar(~p[1]) || crc16_ccitt(p + 2, size) != crc)
+            {
+                ++naks;
+                send(QByteArray(1, XMODEM_NAK));
+                continue;
+            }
+
+            // a repeated block has been acknowledged already
+            if (p[0] == expected)
+            {
+                data.append(packet.constData() + 2, size);
+                ++packets;
+                ++expected;
+            }
+            send(QByteArray(1, XMODEM_ACK));
+        }
+    }
+
+private:
+    void send(const QByteArray &bytes)
+    {
+        if (::write(fd, bytes.constData(), bytes.size()) != bytes.size())
+            qWarning("receiver write failed: %s", strerror(errno));
+    }
+
+    bool read(int len, QByteArray *out)
+    {
+        while (pending.size() < len)
+        {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, RECEIVE_TIMEOUT_MS) <= 0)
+                return false;
+
+            char buf[4096];
+            const ssize_t count = ::read(fd, buf, sizeof(buf));
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            pending.append(buf, count);
+        }
+
+        *out = pending.left(len);
+        pending.remove(0, len);
+        return true;
+    }
+};
+
+/**
+ * \brief one transfer over its own pseudo-terminal pair
+ */
+struct TransferLink
+{
+    int                         master_fd;
+    int                         slave_fd;
+    QSerialPort                 *serial;
+    FileTransfer                *transfer;
+    XModemReceiver              *receiver;
+    FileTransfer::TransferError error;
+    qint64                      nsecs;
+    bool                        ended;
+
+    TransferLink() :
+        master_fd(-1), slave_fd(-1), serial(0), transfer(0), receiver(0),
+        error(FileTransfer::UnknownError), nsecs(0), ended(false)
+    {
+    }
+
+    ~TransferLink()
+    {
+        if (receiver)
+            receiver->wait();
+        delete receiver;
+        delete transfer;
+        delete serial;
+        if (master_fd >= 0)
+            ::close(master_fd);
+        if (slave_fd >= 0)
+            ::close(slave_fd);
+    }
+
+    /**
+     * \brief open a pty pair, its slave side as a serial port
+     */
+    bool open(QString *error_string)
+    {
+        char slave_name[256];
+        if (openpty(&master_fd, &slave_fd, slave_name, 0, 0) < 0)
+        {
+            *error_string = QStringLiteral("openpty failed: %1").arg(strerror(errno));
+            return false;
+        }
+
+        // slave side in raw mode
+        struct termios tio;
+        tcgetattr(slave_fd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave_fd, TCSANOW, &tio);
+
+        serial = new QSerialPort(QString::fromLocal8Bit(slave_name));
+        if (!serial->open(QIODevice::ReadWrite))
+        {
+            *error_string = serial->errorString();
+            return false;
+        }
+
+        return true;
+    }
+};
+
+/**
+ * \brief add the acknowledgement round-trip times measured by a transfer
+ */
+static void addRoundTrips(QJsonObject *result, const FileTransfer::Statistics &stats)
+{
+    (*result)["rtt_count"] = stats.rtt_count;
+    (*result)["rtt_min_ms"] = stats.rtt_min_usecs / 1e3;
+    (*result)["rtt_avg_ms"] = stats.rtt_total_usecs / 1e3 / qMax(stats.rtt_count, 1);
+    (*result)["rtt_max_ms"] = stats.rtt_max_usecs / 1e3;
+}
+
+/**
+ * \brief generate a file of random content
+ */
+static bool writeRandomFile(QTemporaryFile *file, int size, QByteArray *content)
+{
+    *content = QByteArray(size, 0);
+    for (int i = 0; i < size; ++i)
+        (*content)[i] = char(qrand());
+
+    if (!file->open() || file->write(*content) != size)
+        return false;
+    file->close();
+    return true;
+}
+
+QJsonObject benchmarkXModem(int file_size, int ports)
+{
+    QJsonObject result;
+
+    QByteArray content;
+    QTemporaryFile file;
+    if (!writeRandomFile(&file, file_size, &content))
+    {
+        result["error"] = QStringLiteral("can't write temporary file");
+        return result;
+    }
+
+    QList<TransferLink *> links;
+    for (int i = 0; i < ports; ++i)
+    {
+        links.append(new TransferLink);
+
+        QString error_string;
+        if (!links.last()->open(&error_string))
+        {
+            result["error"] = error_string;
+            qDeleteAll(links);
+            return result;
+        }
+        links.last()->receiver = new XModemReceiver(links.last()->master_fd);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // all transfers run at once, each in its own thread
+    QEventLoop loop;
+    int running = 0;
+    foreach (TransferLink *link, links)
+    {
+        link->transfer = new XModemTransfer(0, link->serial, file.fileName());
+        if (!link->transfer->startTransfer())
+            continue;
+
+        // connected after FileTransfer own handler, which gives the serial
+        // port back to this thread
+        QObject::connect(link->transfer, &FileTransfer::transferEnded, &loop,
+                         [&, link](FileTransfer::TransferError transfer_error) {
+            link->error = transfer_error;
+            link->nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+            link->ended = true;
+            if (--running == 0)
+                loop.quit();
+        });
+
+        ++running;
+        link->receiver->start();
+    }
+
+    if (running > 0)
+        loop.exec();
+
+    const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+    QJsonArray transfers;
+    bool verified = true;
+    foreach (TransferLink *link, links)
+    {
+        link->receiver->wait();
+
+        QJsonObject transfer;
+        transfer["error"] = FileTransfer::errorString(link->error);
+        transfer["seconds"] = link->nsecs / 1e9;
+        transfer["throughput_bytes_per_s"] = link->ended ? file_size * 1e9 / link->nsecs : 0.0;
+        transfer["packets"] = (double)link->receiver->packets;
+        transfer["naks"] = (double)link->receiver->naks;
+        addRoundTrips(&transfer, link->transfer->statistics());
+        transfer["verified"] = link->receiver->completed &&
+                link->receiver->data.left(file_size) == content;
+        transfers.append(transfer);
+
+        verified = verified && transfer["verified"].toBool();
+    }
+    qDeleteAll(links);
+
+    result["file_size"] = file_size;
+    result["ports"] = ports;
+    result["seconds"] = nsecs / 1e9;
+    result["throughput_bytes_per_s"] = double(file_size) * ports * 1e9 / nsecs;
+    result["transfers"] = transfers;
+    result["verified"] = verified;
+    return result;
+}
+
+/**
+ * \brief start rz on the master side of a pty pair
+ * \param program  rz executable
+ * \param fd       pty master, rz standard input and output
+ * \param dir      directory receiving files
+ * \return rz process id, -1 on error
+ */
+static pid_t startRz(const QString &program, int fd, const QString &dir)
+{
+    // nothing but async-signal-safe calls once forked
+    const QByteArray path = QFile::encodeName(program);
+    const QByteArray cwd = QFile::encodeName(dir);
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        const int null_fd = ::open("/dev/null", O_WRONLY);
+        if (chdir(cwd.constData()) < 0 || dup2(fd, 0) < 0 || dup2(fd, 1) < 0 || dup2(null_fd, 2) < 0)
+            _exit(127);
+        execl(path.constData(), path.constData(), "-q", (char *)0);
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * \brief upload a file with ZModemTransfer to rz
+ * \param rz       rz executable
+ * \param filename file to upload
+ * \param window   ZModem window, 0 for none
+ * \param dir      directory where rz writes the file
+ * \return duration, throughput, bytes actually sent and retries
+ */
+static QJsonObject runZModem(const QString &rz, const QString &filename, int window, const QString &dir)
+{
+    QJsonObject result;
+
+    TransferLink link;
+    QString error_string;
+    if (!link.open(&error_string))
+    {
+        result["error"] = error_string;
+        return result;
+    }
+
+    const pid_t pid = startRz(rz, link.master_fd, dir);
+    if (pid < 0)
+    {
+        result["error"] = QStringLiteral("fork failed: %1").arg(strerror(errno));
+        return result;
+    }
+
+    ZModemTransfer *transfer = new ZModemTransfer(0, link.serial, QStringList(filename));
+    transfer->setWindow(window);
+    link.transfer = transfer;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QEventLoop loop;
+    QObject::connect(transfer, &FileTransfer::transferEnded, &loop,
+                     [&](FileTransfer::TransferError transfer_error) {
+        link.error = transfer_error;
+        link.nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+        loop.quit();
+    });
+    if (transfer->startTransfer())
+        loop.exec();
+
+    // rz exits once the session is over
+    if (link.error != FileTransfer::NoError)
+        kill(pid, SIGTERM);
+    waitpid(pid, 0, 0);
+
+    const FileTransfer::Statistics stats = transfer->statistics();
+    result["error"] = FileTransfer::errorString(link.error);
+    result["seconds"] = link.nsecs / 1e9;
+    result["bytes_sent"] = (double)stats.bytes;
+    result["throughput_bytes_per_s"] = stats.bytes * 1e9 / qMax<qint64>(link.nsecs, 1);
+    result["retries"] = stats.retries;
+    addRoundTrips(&result, stats);
+    return result;
+}
+
+QJsonObject benchmarkZModem(int file_size, int window)
+{
+    QJsonObject result;
+
+    QString rz = QStandardPaths::findExecutable(QStringLiteral("rz"));
+    if (rz.isEmpty())
+        rz = QStandardPaths::findExecutable(QStringLiteral("lrz"));
+    if (rz.isEmpty())
+    {
+        result["error"] = QStringLiteral("rz not found, lrzsz is needed");
+        return result;
+    }
+
+    QByteArray content;
+    QTemporaryFile file;
+    QTemporaryDir dir;
+    if (!writeRandomFile(&file, file_size, &content) || !dir.isValid())
+    {
+        result["error"] = QStringLiteral("can't write temporary file");
+        return result;
+    }
+
+    // rz writes the file under the same name
+    QFile received(dir.path() + QLatin1Char('/') + QFileInfo(file.fileName()).fileName());
+
+    // whole upload
+    QJsonObject full = runZModem(rz, file.fileName(), window, dir.path());
+    full["verified"] = received.open(QIODevice::ReadOnly) && received.readAll() == content;
+    received.close();
+
+    // upload interrupted at half, then sent again
+    const int kept = file_size / 2;
+    received.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    received.write(content.left(kept));
+    received.close();
+
+    QJsonObject resume = runZModem(rz, file.fileName(), window, dir.path());
+    resume["verified"] = resume["bytes_sent"].toDouble() == file_size - kept &&
+            received.open(QIODevice::ReadOnly) && received.readAll() == content;
+    received.close();
+
+    result["file_size"] = file_size;
+    result["window"] = window;
+    result["full"] = full;
+    result["resume"] = resume;
+    result["verified"] = full["verified"].toBool() && resume["verified"].toBool();
+    return result;
+}
@@ -0,0 +1,48 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief cutecom-ng file transfer benchmark
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef TRANSFERBENCH_H
+#define TRANSFERBENCH_H
+
+#include <QJsonObject>
+
+/**
+ * \brief upload a file with XModemTransfer to receivers on the other side
+ *  of pseudo-terminal pairs
+ *
+ * the pty has no baud rate, so the throughput only depends on the cost of
+ * the protocol implementation: writes, reads and waits per packet.
+ *
+ * with several ports, all transfers run concurrently from this process,
+ * each one on its own pty pair.
+ *
+ * \param file_size size of the uploaded file, in bytes
+ * \param ports     number of concurrent transfers
+ * \return duration and aggregate throughput, then for each transfer its
+ *  duration, throughput, packets and NAKs, and whether the received data
+ *  matches the file
+ */
+QJsonObject benchmarkXModem(int file_size, int ports);
+
+/**
+ * \brief upload a file with ZModemTransfer to lrzsz rz on the other side of
+ *  a pseudo-terminal pair, then upload it again with half of it already
+ *  received, as after an interrupted transfer
+ *
+ * \param file_size size of the uploaded file, in bytes
+ * \param window    ZModem window, 0 for none
+ * \return for both uploads their duration, throughput, bytes actually sent
+ *  and retries, and whether rz ended up with the whole file, having received
+ *  only the missing half in the second one
+ */
+QJsonObject benchmarkZModem(int file_size, int window);
+
+#endif // TRANSFERBENCH_H
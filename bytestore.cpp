@@ -0,0 +1,196 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ByteStore class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "bytestore.h"
+
+#include <QTemporaryFile>
+#include <QDir>
+
+ByteStore::ByteStore(qint64 memory_limit) :
+    spilled(0),
+    total_size(0),
+    memory_limit(memory_limit),
+    archive_offset(0),
+    spill_file(0),
+    spill_failed(false),
+    cache_index(-1)
+{
+}
+
+ByteStore::~ByteStore()
+{
+    delete spill_file;
+}
+
+void ByteStore::setMemoryLimit(qint64 bytes)
+{
+    memory_limit = bytes;
+    spillSegments();
+}
+
+qint64 ByteStore::memoryLimit() const
+{
+    return memory_limit;
+}
+
+void ByteStore::archiveBefore(qint64 offset)
+{
+    archive_offset = qMax(archive_offset, offset);
+    spillSegments();
+}
+
+qint64 ByteStore::memoryUsage() const
+{
+    return qint64(segments.size() - spilled) * SEGMENT_SIZE;
+}
+
+qint64 ByteStore::size() const
+{
+    return total_size;
+}
+
+void ByteStore::append(const QByteArray &data)
+{
+    const char *p = data.constData();
+    int len = data.size();
+
+    while (len > 0)
+    {
+        if (segments.isEmpty() || segments.last().size() == SEGMENT_SIZE)
+        {
+            // allocate a whole segment at once, appending to it never reallocates
+            QByteArray segment;
+            segment.reserve(SEGMENT_SIZE);
+            segments.append(segment);
+
+            spillSegments();
+        }
+
+        QByteArray &last = segments.last();
+        const int count = qMin(len, SEGMENT_SIZE - last.size());
+        last.append(p, count);
+
+        p += count;
+        len -= count;
+        total_size += count;
+    }
+}
+
+void ByteStore::clear()
+{
+    segments.clear();
+    spilled = 0;
+    total_size = 0;
+    archive_offset = 0;
+    spill_failed = false;
+    cache_index = -1;
+    cache_data.clear();
+
+    delete spill_file;
+    spill_file = 0;
+}
+
+QByteArray ByteStore::read(qint64 offset, qint64 len) const
+{
+    QByteArray result;
+    if (offset < 0 || offset >= total_size)
+        return result;
+
+    len = qMin(len, total_size - offset);
+    result.reserve(len);
+
+    while (len > 0)
+    {
+        const int index = offset / SEGMENT_SIZE;
+        const int start = offset % SEGMENT_SIZE;
+        const int count = qMin<qint64>(len, SEGMENT_SIZE - start);
+
+        result.append(segment(index).constData() + start, count);
+
+        offset += count;
+        len -= count;
+    }
+
+    return result;
+}
+
+int ByteStore::segmentCount() const
+{
+    return segments.size();
+}
+
+QByteArray ByteStore::segment(int index) const
+{
+    if (index >= spilled)
+        return segments.at(index);
+
+    if (index != cache_index)
+    {
+        // spilled segments are stored in order, all full
+        spill_file->seek(qint64(index) * SEGMENT_SIZE);
+        cache_data = spill_file->read(SEGMENT_SIZE);
+        cache_index = index;
+    }
+    return cache_data;
+}
+
+ByteStore::Snapshot ByteStore::snapshot() const
+{
+    Snapshot snap;
+    snap.spill_filename = spill_file ? spill_file->fileName() : QString();
+    snap.spilled = spilled;
+    snap.size = total_size;
+
+    // full segments are never modified again and can be shared, the last
+    // one is copied so that appending to it never detaches it
+    snap.segments.reserve(segments.size() - spilled);
+    for (int i = spilled; i < segments.size(); ++i)
+    {
+        const QByteArray &segment = segments.at(i);
+        if (segment.size() == SEGMENT_SIZE)
+            snap.segments.append(segment);
+        else
+            snap.segments.append(QByteArray(segment.constData(), segment.size()));
+    }
+
+    return snap;
+}
+
+void ByteStore::spillSegments()
+{
+    while (!spill_failed && spilled < segments.size() - 1 &&
+           (memoryUsage() > memory_limit || qint64(spilled + 1) * SEGMENT_SIZE <= archive_offset))
+    {
+        if (!spill_file)
+        {
+            spill_file = new QTemporaryFile(QDir::tempPath() + QStringLiteral("/cutecom-ng-XXXXXX.scrollback"));
+            if (!spill_file->open())
+            {
+                spill_failed = true;
+                return;
+            }
+        }
+
+        spill_file->seek(qint64(spilled) * SEGMENT_SIZE);
+        if (spill_file->write(segments.at(spilled)) != SEGMENT_SIZE)
+        {
+            // keep data in memory rather than losing it
+            spill_failed = true;
+            return;
+        }
+
+        // spilled segments may be read through another file handle, see snapshot()
+        spill_file->flush();
+
+        segments[spilled] = QByteArray();
+        ++spilled;
+    }
+}
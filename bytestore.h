@@ -0,0 +1,174 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ByteStore class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef BYTESTORE_H
+#define BYTESTORE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include <QMetaType>
+
+class QTemporaryFile;
+
+/**
+ * \brief append-only byte storage with a capped memory footprint
+ *
+ * data is stored in fixed-size segments, so appending never moves
+ * previously stored data and the segment holding a given offset is found
+ * with a division.
+ *
+ * once in-memory segments exceed the memory limit, the oldest ones are
+ * spilled to a temporary file, from which they are transparently read back.
+ * Data before an archive offset is spilled whatever the memory limit.
+ */
+class ByteStore
+{
+public:
+    /// size of a segment, all segments but the last one are full
+    static const int SEGMENT_SIZE = 256 * 1024;
+
+    /**
+     * \brief frozen content of a store, readable from another thread
+     *
+     * in-memory segments are shared with the store, spilled segments are
+     * read from the spill file, which is never rewritten.
+     */
+    struct Snapshot
+    {
+        /// spill file name, empty if nothing has been spilled
+        QString             spill_filename;
+
+        /// number of segments in the spill file
+        int                 spilled;
+
+        /// in-memory segments, following spilled ones
+        QVector<QByteArray> segments;
+
+        /// total amount of bytes
+        qint64              size;
+    };
+
+private:
+
+    /// segments, spilled ones are null
+    QVector<QByteArray> segments;
+
+    /// number of segments spilled to disk, always the oldest ones
+    int                 spilled;
+
+    /// total amount of bytes stored
+    qint64              total_size;
+
+    /// maximum amount of memory used by segments
+    qint64              memory_limit;
+
+    /// segments ending at or before this offset are spilled
+    qint64              archive_offset;
+
+    /// spill file, created when first needed
+    QTemporaryFile      *spill_file;
+
+    /// set if the spill file could not be written, data then stays in memory
+    bool                spill_failed;
+
+    /// last segment read back from the spill file
+    mutable int         cache_index;
+
+    /// content of last segment read back from the spill file
+    mutable QByteArray  cache_data;
+
+    Q_DISABLE_COPY(ByteStore)
+
+public:
+
+    /**
+     * \brief create an empty store
+     * \param memory_limit maximum amount of memory used by segments
+     */
+    explicit ByteStore(qint64 memory_limit = 64 * 1024 * 1024);
+    ~ByteStore();
+
+    /**
+     * \brief set the maximum amount of memory used by segments
+     * \note the last segment always stays in memory
+     */
+    void setMemoryLimit(qint64 bytes);
+
+    /**
+     * \brief return the maximum amount of memory used by segments
+     */
+    qint64 memoryLimit() const;
+
+    /**
+     * \brief spill data preceding an offset, even under the memory limit
+     * \note the archive offset is never moved backwards, until clear()
+     */
+    void archiveBefore(qint64 offset);
+
+    /**
+     * \brief return the amount of memory currently used by segments
+     */
+    qint64 memoryUsage() const;
+
+    /**
+     * \brief return the total amount of bytes stored
+     */
+    qint64 size() const;
+
+    /**
+     * \brief append data to the store
+     */
+    void append(const QByteArray &data);
+
+    /**
+     * \brief remove all data
+     */
+    void clear();
+
+    /**
+     * \brief read stored data
+     * \param offset offset of first byte
+     * \param len    amount of bytes to read
+     * \return data read, shorter than len at the end of the store
+     */
+    QByteArray read(qint64 offset, qint64 len) const;
+
+    /**
+     * \brief return the number of segments
+     */
+    int segmentCount() const;
+
+    /**
+     * \brief return a segment content
+     *
+     * in-memory segments are returned without copy (implicit sharing),
+     * spilled segments are read back from disk
+     */
+    QByteArray segment(int index) const;
+
+    /**
+     * \brief return a snapshot of current content
+     */
+    Snapshot snapshot() const;
+
+private:
+
+    /**
+     * \brief move oldest segments to disk while over the memory limit, or
+     *  before the archive offset
+     */
+    void spillSegments();
+};
+
+Q_DECLARE_METATYPE(ByteStore::Snapshot)
+
+#endif // BYTESTORE_H
@@ -0,0 +1,338 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief capture dump file format implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "capturefile.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+/// capture file magic
+static const char CAPTURE_MAGIC[8] = { 'C', 'C', 'N', 'G', 'C', 'A', 'P', 0 };
+
+/// current format version
+const quint32 CAPTURE_VERSION = 1;
+
+/// distance in bytes between two checkpoints
+const qint64 CHECKPOINT_INTERVAL = 64 * 1024;
+
+/// number of checkpoints per Index record
+const int CHECKPOINTS_PER_INDEX = 64;
+
+/// size of End record, header included
+const int END_RECORD_SIZE = sizeof(CaptureRecordHeader) + sizeof(CaptureEndPayload);
+
+/**
+ * \brief round size up to the record alignment
+ */
+static inline qint64 padded(qint64 size)
+{
+    return (size + 7) & ~Q_INT64_C(7);
+}
+
+CaptureWriter::CaptureWriter() :
+    start_ns(0),
+    offset(0),
+    rx_bytes(0),
+    last_checkpoint(0),
+    last_index(-1)
+{
+}
+
+void CaptureWriter::begin(QByteArray *out, qint64 start)
+{
+    start_ns = start;
+    rx_bytes = 0;
+    last_index = -1;
+    checkpoints.clear();
+
+    CaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = qToLittleEndian(CAPTURE_VERSION);
+    header.header_size = qToLittleEndian<quint32>(sizeof(header));
+    header.start_time = qToLittleEndian(QDateTime::currentMSecsSinceEpoch());
+    header.checkpoint_interval = qToLittleEndian<quint32>(CHECKPOINT_INTERVAL);
+
+    out->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset = sizeof(header);
+
+    // first record will be a checkpoint
+    last_checkpoint = offset - CHECKPOINT_INTERVAL;
+}
+
+void CaptureWriter::append(QByteArray *out, CaptureRecordType type, qint64 timestamp,
+                           const char *data, int len)
+{
+    const qint64 relative_ts = timestamp - start_ns;
+
+    if (offset - last_checkpoint >= CHECKPOINT_INTERVAL)
+    {
+        if (checkpoints.size() == CHECKPOINTS_PER_INDEX)
+            appendIndex(out, relative_ts);
+
+        CaptureIndexEntry entry;
+        entry.offset = offset;
+        entry.timestamp = relative_ts;
+        entry.rx_offset = rx_bytes;
+        checkpoints.append(entry);
+        last_checkpoint = offset;
+    }
+
+    appendRecord(out, type, relative_ts, data, len);
+
+    if (type == CaptureReceived)
+        rx_bytes += len;
+}
+
+void CaptureWriter::end(QByteArray *out, qint64 timestamp)
+{
+    const qint64 relative_ts = timestamp - start_ns;
+
+    if (!checkpoints.isEmpty())
+        appendIndex(out, relative_ts);
+
+    CaptureEndPayload payload;
+    payload.last_index = qToLittleEndian(last_index);
+    payload.rx_bytes = qToLittleEndian(rx_bytes);
+    appendRecord(out, CaptureEnd, relative_ts,
+                 reinterpret_cast<const char*>(&payload), sizeof(payload));
+}
+
+void CaptureWriter::appendRecord(QByteArray *out, CaptureRecordType type, qint64 timestamp,
+                                 const char *data, int len)
+{
+    static const char padding[8] = { 0 };
+
+    CaptureRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.timestamp = qToLittleEndian(timestamp);
+    header.length = qToLittleEndian<quint32>(len);
+    header.type = type;
+
+    out->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out->append(data, len);
+    out->append(padding, padded(len) - len);
+
+    offset += sizeof(header) + padded(len);
+}
+
+void CaptureWriter::appendIndex(QByteArray *out, qint64 timestamp)
+{
+    QByteArray payload;
+    payload.reserve(sizeof(CaptureIndexHeader) + checkpoints.size() * sizeof(CaptureIndexEntry));
+
+    CaptureIndexHeader header;
+    header.previous = qToLittleEndian(last_index);
+    header.count = qToLittleEndian<quint32>(checkpoints.size());
+    header.reserved = 0;
+    payload.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    foreach (const CaptureIndexEntry &checkpoint, checkpoints)
+    {
+        CaptureIndexEntry entry;
+        entry.offset = qToLittleEndian(checkpoint.offset);
+        entry.timestamp = qToLittleEndian(checkpoint.timestamp);
+        entry.rx_offset = qToLittleEndian(checkpoint.rx_offset);
+        payload.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    checkpoints.clear();
+
+    last_index = offset;
+    appendRecord(out, CaptureIndex, timestamp, payload.constData(), payload.size());
+}
+
+CaptureReader::CaptureReader() :
+    map(0),
+    map_size(0),
+    start_time(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::isCaptureFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return file.read(sizeof(CAPTURE_MAGIC)) == QByteArray(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+}
+
+bool CaptureReader::open(const QString &filename)
+{
+    close();
+
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(CaptureFileHeader))
+    {
+        close();
+        return false;
+    }
+
+    map_size = file.size();
+    map = file.map(0, map_size);
+    if (!map)
+    {
+        close();
+        return false;
+    }
+
+    CaptureFileHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+            qFromLittleEndian(header.version) != CAPTURE_VERSION)
+    {
+        close();
+        return false;
+    }
+    start_time = qFromLittleEndian(header.start_time);
+
+    loadIndex();
+    return true;
+}
+
+void CaptureReader::close()
+{
+    if (map)
+        file.unmap(const_cast<uchar*>(map));
+    map = 0;
+    map_size = 0;
+    checkpoints.clear();
+    file.close();
+}
+
+qint64 CaptureReader::startTime() const
+{
+    return start_time;
+}
+
+qint64 CaptureReader::firstRecord() const
+{
+    return sizeof(CaptureFileHeader);
+}
+
+bool CaptureReader::readRecord(qint64 offset, Record *record, qint64 *next) const
+{
+    if (offset < 0 || offset + (qint64)sizeof(CaptureRecordHeader) > map_size)
+        return false;
+
+    CaptureRecordHeader header;
+    memcpy(&header, map + offset, sizeof(header));
+
+    const qint64 length = qFromLittleEndian(header.length);
+    const qint64 payload_offset = offset + sizeof(header);
+
+    // truncated capture (eg: application crashed)
+    if (payload_offset + length > map_size)
+        return false;
+
+    record->offset = offset;
+    record->timestamp = qFromLittleEndian(header.timestamp);
+    record->type = header.type;
+    record->data = reinterpret_cast<const char*>(map + payload_offset);
+    record->length = length;
+
+    *next = payload_offset + padded(length);
+    return true;
+}
+
+qint64 CaptureReader::seekTime(qint64 timestamp) const
+{
+    // last checkpoint not after timestamp
+    QVector<CaptureIndexEntry>::const_iterator it =
+        std::upper_bound(checkpoints.constBegin(), checkpoints.constEnd(), timestamp,
+            [](qint64 ts, const CaptureIndexEntry &entry) { return ts < entry.timestamp; });
+
+    if (it == checkpoints.constBegin())
+        return firstRecord();
+    return (it - 1)->offset;
+}
+
+const QVector<CaptureIndexEntry>& CaptureReader::index() const
+{
+    return checkpoints;
+}
+
+void CaptureReader::loadIndex()
+{
+    Record record;
+    qint64 next;
+    QVector<qint64> index_offsets;
+
+    // properly closed capture: follow the index chain from End record
+    const qint64 end_offset = map_size - END_RECORD_SIZE;
+    if (end_offset >= firstRecord() && readRecord(end_offset, &record, &next) &&
+            record.type == CaptureEnd && record.length == sizeof(CaptureEndPayload))
+    {
+        CaptureEndPayload payload;
+        memcpy(&payload, record.data, sizeof(payload));
+
+        qint64 index_offset = qFromLittleEndian(payload.last_index);
+        while (index_offset >= 0 && readRecord(index_offset, &record, &next) &&
+                record.type == CaptureIndex && record.length >= (int)sizeof(CaptureIndexHeader))
+        {
+            index_offsets.append(index_offset);
+
+            CaptureIndexHeader header;
+            memcpy(&header, record.data, sizeof(header));
+            const qint64 previous = qFromLittleEndian(header.previous);
+
+            // each index precedes the next one, a corrupt chain could loop
+            if (previous >= index_offset)
+                break;
+            index_offset = previous;
+        }
+
+        // the chain was walked from the last index
+        std::reverse(index_offsets.begin(), index_offsets.end());
+    }
+    else
+    {
+        // no End record: hop from record to record, payloads are not read
+        qint64 offset = firstRecord();
+        while (readRecord(offset, &record, &next))
+        {
+            if (record.type == CaptureIndex)
+                index_offsets.append(offset);
+            offset = next;
+        }
+    }
+
+    foreach (qint64 index_offset, index_offsets)
+    {
+        if (!readRecord(index_offset, &record, &next) ||
+                record.length < (int)sizeof(CaptureIndexHeader))
+            continue;
+
+        CaptureIndexHeader header;
+        memcpy(&header, record.data, sizeof(header));
+        const quint32 count = qMin<quint32>(qFromLittleEndian(header.count),
+            (record.length - sizeof(header)) / sizeof(CaptureIndexEntry));
+
+        const char *entries = record.data + sizeof(header);
+        for (quint32 i = 0; i < count; ++i)
+        {
+            CaptureIndexEntry entry;
+            memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+            entry.offset = qFromLittleEndian(entry.offset);
+            entry.timestamp = qFromLittleEndian(entry.timestamp);
+            entry.rx_offset = qFromLittleEndian(entry.rx_offset);
+            checkpoints.append(entry);
+        }
+    }
+}
@@ -0,0 +1,301 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief capture dump file format
+ *
+ * a capture file keeps every chunk exchanged with the serial port, along
+ * with its direction and a monotonic timestamp. It is laid out so that it
+ * can be memory-mapped and walked without parsing the data:
+ *
+ *  - CaptureFileHeader
+ *  - records: CaptureRecordHeader followed by its payload, padded to 8 bytes
+ *
+ * every CHECKPOINT_INTERVAL bytes, the writer records a checkpoint (file
+ * offset, timestamp and amount of received bytes so far); checkpoints are
+ * periodically written in an Index record which also holds the offset of
+ * the previous Index record. When the file is properly closed, an End
+ * record gives the offset of the last Index record, so the whole seek index
+ * is loaded by following the chain backwards.
+ *
+ * all integers are little endian
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+/**
+ * \brief capture file header
+ */
+struct CaptureFileHeader
+{
+    /// "CCNGCAP" followed by a nul char
+    char    magic[8];
+
+    /// format version
+    quint32 version;
+
+    /// size of this header
+    quint32 header_size;
+
+    /// capture start time, in milliseconds since epoch (UTC)
+    qint64  start_time;
+
+    /// distance in bytes between two checkpoints
+    quint32 checkpoint_interval;
+
+    quint32 reserved;
+};
+
+/**
+ * \brief header of each record
+ */
+struct CaptureRecordHeader
+{
+    /// nanoseconds since capture start
+    qint64  timestamp;
+
+    /// payload length, padding excluded
+    quint32 length;
+
+    /// CaptureRecordType
+    quint8  type;
+
+    quint8  reserved[3];
+};
+
+/**
+ * \brief capture record types
+ */
+enum CaptureRecordType
+{
+    /// data received from the serial port
+    CaptureReceived     = 0,
+    /// data sent to the serial port
+    CaptureTransmitted  = 1,
+    /// seek index: CaptureIndexHeader followed by CaptureIndexEntry's
+    CaptureIndex        = 2,
+    /// end of capture: CaptureEndPayload
+    CaptureEnd          = 3
+};
+
+/**
+ * \brief seek index entry (checkpoint)
+ */
+struct CaptureIndexEntry
+{
+    /// file offset of a record header
+    qint64 offset;
+
+    /// timestamp of that record
+    qint64 timestamp;
+
+    /// amount of received bytes preceding that record
+    qint64 rx_offset;
+};
+
+/**
+ * \brief payload header of Index records
+ */
+struct CaptureIndexHeader
+{
+    /// file offset of previous Index record, -1 for the first one
+    qint64  previous;
+
+    /// number of CaptureIndexEntry following
+    quint32 count;
+
+    quint32 reserved;
+};
+
+/**
+ * \brief payload of End record
+ */
+struct CaptureEndPayload
+{
+    /// file offset of the last Index record, -1 if none
+    qint64 last_index;
+
+    /// total amount of received bytes
+    qint64 rx_bytes;
+};
+
+/**
+ * \brief encode a capture stream
+ *
+ * the writer only produces bytes, it's up to the caller to store them
+ */
+class CaptureWriter
+{
+private:
+
+    /// monotonic timestamp of capture start, see ChunkRing::timestamp()
+    qint64  start_ns;
+
+    /// amount of bytes produced so far
+    qint64  offset;
+
+    /// amount of received bytes so far
+    qint64  rx_bytes;
+
+    /// offset of last checkpoint
+    qint64  last_checkpoint;
+
+    /// offset of last Index record
+    qint64  last_index;
+
+    /// checkpoints not yet written in an Index record
+    QVector<CaptureIndexEntry> checkpoints;
+
+public:
+
+    CaptureWriter();
+
+    /**
+     * \brief start a new capture and append file header to out
+     * \param start_ns monotonic timestamp of capture start
+     */
+    void begin(QByteArray *out, qint64 start_ns);
+
+    /**
+     * \brief append a data record to out
+     * \param type      CaptureReceived or CaptureTransmitted
+     * \param timestamp monotonic timestamp, see ChunkRing::timestamp()
+     */
+    void append(QByteArray *out, CaptureRecordType type, qint64 timestamp,
+                const char *data, int len);
+
+    /**
+     * \brief append pending index and End record to out
+     * \param timestamp monotonic timestamp of capture end, see ChunkRing::timestamp()
+     */
+    void end(QByteArray *out, qint64 timestamp);
+
+private:
+
+    /**
+     * \brief append a record to out
+     */
+    void appendRecord(QByteArray *out, CaptureRecordType type, qint64 timestamp,
+                      const char *data, int len);
+
+    /**
+     * \brief append an Index record with pending checkpoints
+     */
+    void appendIndex(QByteArray *out, qint64 timestamp);
+};
+
+/**
+ * \brief memory-mapped capture file reader
+ */
+class CaptureReader
+{
+public:
+
+    /**
+     * \brief a record, pointing into the mapped file
+     */
+    struct Record
+    {
+        /// file offset of the record header
+        qint64      offset;
+
+        /// nanoseconds since capture start
+        qint64      timestamp;
+
+        /// CaptureRecordType
+        int         type;
+
+        /// payload
+        const char *data;
+
+        /// payload length
+        int         length;
+    };
+
+private:
+
+    /// capture file
+    QFile       file;
+
+    /// file mapping
+    const uchar *map;
+
+    /// mapped size
+    qint64      map_size;
+
+    /// capture start time, ms since epoch
+    qint64      start_time;
+
+    /// all checkpoints, sorted by offset
+    QVector<CaptureIndexEntry> checkpoints;
+
+public:
+
+    CaptureReader();
+    ~CaptureReader();
+
+    /**
+     * \brief return true if given file starts like a capture file
+     */
+    static bool isCaptureFile(const QString &filename);
+
+    /**
+     * \brief map a capture file and load its seek index
+     * \return false if the file is not a readable capture file
+     */
+    bool open(const QString &filename);
+
+    /**
+     * \brief unmap and close capture file
+     */
+    void close();
+
+    /**
+     * \brief capture start time, in milliseconds since epoch
+     */
+    qint64 startTime() const;
+
+    /**
+     * \brief offset of the first record
+     */
+    qint64 firstRecord() const;
+
+    /**
+     * \brief read record at given offset
+     * \param offset record offset, 0 is the first record
+     * \param record filled with record data
+     * \param next   filled with next record offset
+     * \return false at end of file or if record is truncated/invalid
+     */
+    bool readRecord(qint64 offset, Record *record, qint64 *next) const;
+
+    /**
+     * \brief return offset of a record preceding given timestamp, as close
+     *  to it as the seek index allows
+     * \param timestamp nanoseconds since capture start
+     */
+    qint64 seekTime(qint64 timestamp) const;
+
+    /**
+     * \brief return checkpoints of the seek index
+     */
+    const QVector<CaptureIndexEntry>& index() const;
+
+private:
+
+    /**
+     * \brief load checkpoints from Index records
+     */
+    void loadIndex();
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,126 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ChunkRing class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "chunkring.h"
+
+#include <chrono>
+#include <cstring>
+
+ChunkRing::ChunkRing(int capacity_log2) :
+    head(0),
+    tail(0),
+    notify_pending(0)
+{
+    Q_ASSERT_X(capacity_log2 > 4 && capacity_log2 < 31,
+               "ChunkRing::ChunkRing", "invalid ring capacity");
+
+    capacity = 1u << capacity_log2;
+    mask = capacity - 1;
+    ring = new char[capacity];
+}
+
+ChunkRing::~ChunkRing()
+{
+    delete [] ring;
+}
+
+int ChunkRing::size() const
+{
+    return capacity;
+}
+
+int ChunkRing::maxPushSize() const
+{
+    const quint32 used = head.load() - tail.loadAcquire();
+    const int room = capacity - used - HEADER_SIZE;
+    return room > 0 ? room : 0;
+}
+
+bool ChunkRing::push(const char *data, int len, qint64 timestamp)
+{
+    const quint32 h = head.load();
+    const quint32 used = h - tail.loadAcquire();
+
+    if (capacity - used < static_cast<quint32>(HEADER_SIZE + len))
+        return false;
+
+    const quint32 length = len;
+    copyIn(h, &length, sizeof(length));
+    copyIn(h + sizeof(length), &timestamp, sizeof(timestamp));
+    copyIn(h + HEADER_SIZE, data, len);
+
+    // publish the record only once it is complete
+    head.storeRelease(h + HEADER_SIZE + len);
+    return true;
+}
+
+bool ChunkRing::pop(QByteArray *data, qint64 *timestamp)
+{
+    const quint32 t = tail.load();
+    if (head.loadAcquire() == t)
+        return false;
+
+    quint32 length;
+    copyOut(t, &length, sizeof(length));
+    copyOut(t + sizeof(length), timestamp, sizeof(*timestamp));
+
+    data->resize(length);
+    copyOut(t + HEADER_SIZE, data->data(), length);
+
+    // give room back to the producer
+    tail.storeRelease(t + HEADER_SIZE + length);
+    return true;
+}
+
+bool ChunkRing::isEmpty() const
+{
+    return head.loadAcquire() == tail.load();
+}
+
+bool ChunkRing::requestNotify()
+{
+    return notify_pending.testAndSetOrdered(0, 1);
+}
+
+void ChunkRing::acknowledgeNotify()
+{
+    notify_pending.storeRelease(0);
+}
+
+void ChunkRing::clear()
+{
+    tail.storeRelease(head.loadAcquire());
+    notify_pending.storeRelease(0);
+}
+
+qint64 ChunkRing::timestamp()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void ChunkRing::copyIn(quint32 pos, const void *src, int len)
+{
+    const quint32 offset = pos & mask;
+    const int first = qMin<quint32>(len, capacity - offset);
+
+    memcpy(ring + offset, src, first);
+    memcpy(ring, static_cast<const char*>(src) + first, len - first);
+}
+
+void ChunkRing::copyOut(quint32 pos, void *dest, int len) const
+{
+    const quint32 offset = pos & mask;
+    const int first = qMin<quint32>(len, capacity - offset);
+
+    memcpy(dest, ring + offset, first);
+    memcpy(static_cast<char*>(dest) + first, ring, len - first);
+}
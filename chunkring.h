@@ -0,0 +1,140 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ChunkRing class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef CHUNKRING_H
+#define CHUNKRING_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+/**
+ * \brief single-producer / single-consumer lock-free ring of data chunks
+ *
+ * the producer (serial reader thread) pushes chunks of received bytes,
+ * each one tagged with its reception timestamp, the consumer (GUI thread)
+ * pops them whenever it has time to. Neither side ever takes a lock or
+ * waits for the other one.
+ *
+ * every chunk is stored as a record: [length (4 bytes)][timestamp (8 bytes)][data]
+ *
+ * head and tail are free-running byte counters, the amount of bytes in use
+ * is always (head - tail), even when the counters wrap around
+ */
+class ChunkRing
+{
+public:
+    /// size of the header preceding each chunk in the ring
+    static const int HEADER_SIZE = 12;
+
+private:
+    /// ring storage
+    char                    *ring;
+
+    /// ring size in bytes (power of 2)
+    quint32                 capacity;
+
+    /// capacity - 1, used to wrap positions
+    quint32                 mask;
+
+    /// write position, only modified by the producer
+    QAtomicInteger<quint32> head;
+
+    /// read position, only modified by the consumer
+    QAtomicInteger<quint32> tail;
+
+    /// 1 if the consumer has been notified and did not drain the ring yet
+    QAtomicInt              notify_pending;
+
+    Q_DISABLE_COPY(ChunkRing)
+
+public:
+
+    /**
+     * \brief create a ring buffer
+     * \param capacity_log2 ring size is 2^capacity_log2 bytes
+     */
+    explicit ChunkRing(int capacity_log2 = 22);
+    ~ChunkRing();
+
+    /**
+     * \brief return the ring size in bytes
+     */
+    int size() const;
+
+    /**
+     * \brief return the biggest chunk that can currently be pushed
+     * \note producer side
+     */
+    int maxPushSize() const;
+
+    /**
+     * \brief push a chunk of data in the ring
+     * \note producer side
+     * \param data      chunk data
+     * \param len       chunk length
+     * \param timestamp chunk timestamp, see ChunkRing::timestamp()
+     * \return false if there is not enough room for the whole chunk
+     */
+    bool push(const char *data, int len, qint64 timestamp);
+
+    /**
+     * \brief pop the oldest chunk
+     * \note consumer side
+     * \param data      filled with chunk data
+     * \param timestamp filled with chunk timestamp
+     * \return false if the ring is empty
+     */
+    bool pop(QByteArray *data, qint64 *timestamp);
+
+    /**
+     * \brief return true if there is no chunk to pop
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief tell if consumer should be notified about pushed chunks
+     * \note producer side
+     * \return true only for the first call since last acknowledgeNotify()
+     */
+    bool requestNotify();
+
+    /**
+     * \brief acknowledge a notification, call it before draining the ring
+     * \note consumer side
+     */
+    void acknowledgeNotify();
+
+    /**
+     * \brief drop all chunks
+     * \warning only call this while no producer is active
+     */
+    void clear();
+
+    /**
+     * \brief monotonic clock used to timestamp chunks
+     * \return nanoseconds since an unspecified, process-wide, point in time
+     */
+    static qint64 timestamp();
+
+private:
+
+    /**
+     * \brief copy len bytes from src to position pos of the ring
+     */
+    void copyIn(quint32 pos, const void *src, int len);
+
+    /**
+     * \brief copy len bytes from position pos of the ring to dest
+     */
+    void copyOut(quint32 pos, void *dest, int len) const;
+};
+
+#endif // CHUNKRING_H
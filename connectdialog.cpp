@@ -11,6 +11,8 @@
 
 #include "connectdialog.h"
 #include "ui_connectdialog.h"
+#include "dumpwriter.h"
+#include "textdecoder.h"
 
 #include <QList>
 #include <QHash>
@@ -39,11 +41,13 @@ ConnectDialog::ConnectDialog(QWidget *parent) :
     default_cfg[QStringLiteral("stop_bits")] = QStringLiteral("1");
     default_cfg[QStringLiteral("parity")] = QStringLiteral("None");
     default_cfg[QStringLiteral("flow_control")] = QStringLiteral("None");
+    default_cfg[QStringLiteral("encoding")] = QString::number(TextDecoder::Utf8);
 
     // define the default values for output dump
     default_cfg[QStringLiteral("dump_enabled")] = QString::number(0);
     default_cfg[QStringLiteral("dump_file")] = QStringLiteral("cutecom-ng.dump");
     default_cfg[QStringLiteral("dump_format")] = QString::number(Raw);
+    default_cfg[QStringLiteral("dump_sync")] = QString::number(DumpWriter::SyncOnClose);
 
     preselectPortConfig(default_cfg);
 }
@@ -120,6 +124,16 @@ void ConnectDialog::fillSettingsLists()
     ui->flowControlList->addItem(QStringLiteral("None"), QSerialPort::NoFlowControl);
     ui->flowControlList->addItem(QStringLiteral("Hardware"), QSerialPort::HardwareControl);
     ui->flowControlList->addItem(QStringLiteral("Software"), QSerialPort::SoftwareControl);
+
+    // fill received data encoding
+    ui->encodingList->addItem(QStringLiteral("UTF-8"), TextDecoder::Utf8);
+    ui->encodingList->addItem(QStringLiteral("Latin-1"), TextDecoder::Latin1);
+    ui->encodingList->addItem(QStringLiteral("CP437"), TextDecoder::Cp437);
+
+    // fill dump file sync policy
+    ui->dumpSyncList->addItem(QStringLiteral("never"), DumpWriter::NoSync);
+    ui->dumpSyncList->addItem(QStringLiteral("on close"), DumpWriter::SyncOnClose);
+    ui->dumpSyncList->addItem(QStringLiteral("on every write"), DumpWriter::SyncOnFlush);
 }
 
 void ConnectDialog::preselectPortConfig(const QHash<QString, QString>& settings)
@@ -131,11 +145,16 @@ void ConnectDialog::preselectPortConfig(const QHash<QString, QString>& settings)
 
     ui->parityList->setCurrentText(settings[QStringLiteral("parity")]);
     ui->flowControlList->setCurrentText(settings[QStringLiteral("flow_control")]);
+    ui->encodingList->setCurrentIndex(
+                ui->encodingList->findData(settings["encoding"].toInt()));
 
     ui->dumpFile->setChecked(settings[QStringLiteral("dump_enabled")] == "1");
     ui->dumpPath->setText(settings[QStringLiteral("dump_file")]);
     ui->dumpRawFmt->setChecked(settings["dump_format"] == QString::number(Raw));
     ui->dumpTextFmt->setChecked(settings["dump_format"] == QString::number(Ascii));
+    ui->dumpCaptureFmt->setChecked(settings["dump_format"] == QString::number(Capture));
+    ui->dumpSyncList->setCurrentIndex(
+                ui->dumpSyncList->findData(settings["dump_sync"].toInt()));
 }
 
 void ConnectDialog::accept()
@@ -151,9 +170,18 @@ void ConnectDialog::accept()
                 ui->parityList->currentIndex()).toString();
     cfg[QStringLiteral("flow_control")] = ui->flowControlList->itemData(
                 ui->flowControlList->currentIndex()).toString();
+    cfg[QStringLiteral("encoding")] = ui->encodingList->itemData(
+                ui->encodingList->currentIndex()).toString();
     cfg[QStringLiteral("dump_enabled")] = ui->dumpFile->isChecked() ? "1" : "0";
     cfg[QStringLiteral("dump_file")] = ui->dumpPath->text();
-    cfg[QStringLiteral("dump_format")] = QString::number(ui->dumpRawFmt->isChecked() ? Raw : Ascii);
+    DumpFormat dump_format = Ascii;
+    if (ui->dumpRawFmt->isChecked())
+        dump_format = Raw;
+    else if (ui->dumpCaptureFmt->isChecked())
+        dump_format = Capture;
+    cfg[QStringLiteral("dump_format")] = QString::number(dump_format);
+    cfg[QStringLiteral("dump_sync")] = ui->dumpSyncList->itemData(
+                ui->dumpSyncList->currentIndex()).toString();
 
     hide();
 
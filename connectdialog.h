@@ -31,8 +31,9 @@ public:
      * \brief dump file formats
      */
     enum DumpFormat {
-        Raw   = 1,
-        Ascii = 2
+        Raw     = 1,
+        Ascii   = 2,
+        Capture = 3
     };
 
 public:
@@ -68,7 +69,9 @@ signals:
      *  - "flow_control"
      *  - "dump_enabled" dump enabled/disabled
      *  - "dump_file" full path of dump file
-     *  - "dump_format" DumpFormat enum 'Raw' or 'Ascii'
+     *  - "dump_format" DumpFormat enum 'Raw', 'Ascii' or 'Capture'
+     *  - "dump_sync" DumpWriter::SyncPolicy enum
+     *  - "encoding" TextDecoder::Encoding enum, encoding of received data
      */
     void openDeviceClicked(const QHash<QString, QString>& config);
 };
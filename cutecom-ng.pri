@@ -0,0 +1,79 @@
+#-------------------------------------------------
+#
+# cutecom-ng sources, shared by the application
+# and the benchmark tool
+#
+#-------------------------------------------------
+
+QT       += core gui serialport uitools
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD $$PWD/libs
+
+SOURCES += $$PWD/mainwindow.cpp \
+    $$PWD/connectdialog.cpp \
+    $$PWD/sessionmanager.cpp \
+    $$PWD/outputmanager.cpp \
+    $$PWD/historycombobox.cpp \
+    $$PWD/history.cpp \
+    $$PWD/xmodemtransfer.cpp \
+    $$PWD/ymodemtransfer.cpp \
+    $$PWD/zmodemtransfer.cpp \
+    $$PWD/filetransfer.cpp \
+    $$PWD/transferinput.cpp \
+    $$PWD/transfersource.cpp \
+    $$PWD/chunkring.cpp \
+    $$PWD/serialreader.cpp \
+    $$PWD/dumpwriter.cpp \
+    $$PWD/capturefile.cpp \
+    $$PWD/replaysource.cpp \
+    $$PWD/bytestore.cpp \
+    $$PWD/textdecoder.cpp \
+    $$PWD/lineindex.cpp \
+    $$PWD/outputview.cpp \
+    $$PWD/searchworker.cpp \
+    $$PWD/searchengine.cpp \
+    $$PWD/triggerengine.cpp \
+    $$PWD/libs/crc16.cpp \
+    $$PWD/libs/crc32.cpp \
+    $$PWD/libs/crcclmul.cpp \
+    $$PWD/libs/xmodem.cpp
+
+HEADERS  += $$PWD/mainwindow.h \
+    $$PWD/connectdialog.h \
+    $$PWD/sessionmanager.h \
+    $$PWD/outputmanager.h \
+    $$PWD/historycombobox.h \
+    $$PWD/history.h \
+    $$PWD/xmodemtransfer.h \
+    $$PWD/ymodemtransfer.h \
+    $$PWD/zmodemtransfer.h \
+    $$PWD/filetransfer.h \
+    $$PWD/transferinput.h \
+    $$PWD/transfersource.h \
+    $$PWD/chunkring.h \
+    $$PWD/serialreader.h \
+    $$PWD/dumpwriter.h \
+    $$PWD/capturefile.h \
+    $$PWD/replaysource.h \
+    $$PWD/bytestore.h \
+    $$PWD/textdecoder.h \
+    $$PWD/lineindex.h \
+    $$PWD/outputview.h \
+    $$PWD/searchworker.h \
+    $$PWD/searchengine.h \
+    $$PWD/triggerengine.h \
+    $$PWD/libs/crc16.h \
+    $$PWD/libs/crc32.h \
+    $$PWD/libs/crcclmul.h \
+    $$PWD/libs/xmodem.h
+
+FORMS    += $$PWD/mainwindow.ui \
+    $$PWD/connectdialog.ui \
+    $$PWD/searchwidget.ui
+
+RESOURCES += \
+    $$PWD/cutecom-ng.qrc
@@ -4,48 +4,15 @@
 #
 #-------------------------------------------------
 
-QT       += core gui serialport uitools
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
 TARGET = cutecom-ng
 TEMPLATE = app
 DESTDIR = bin
-INCLUDEPATH += libs
 
 OBJECTS_DIR = .generated/
 MOC_DIR = .generated/
 RCC_DIR = .generated/
 UI_DIR = .generated/
 
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    connectdialog.cpp \
-    sessionmanager.cpp \
-    outputmanager.cpp \
-    historycombobox.cpp \
-    history.cpp \
-    searchhighlighter.cpp \
-    xmodemtransfer.cpp \
-    filetransfer.cpp \
-    libs/crc16.cpp \
-    libs/xmodem.cpp
-
-HEADERS  += mainwindow.h \
-    connectdialog.h \
-    sessionmanager.h \
-    outputmanager.h \
-    historycombobox.h \
-    history.h \
-    searchhighlighter.h \
-    xmodemtransfer.h \
-    filetransfer.h \
-    libs/crc16.h \
-    libs/xmodem.h
-
-FORMS    += mainwindow.ui \
-    connectdialog.ui \
-    searchwidget.ui
+include(cutecom-ng.pri)
 
-RESOURCES += \
-    cutecom-ng.qrc
+SOURCES += main.cpp
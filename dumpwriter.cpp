@@ -0,0 +1,224 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief DumpWriter class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "dumpwriter.h"
+#include "chunkring.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/// default amount of pending data triggering a flush
+const int DEFAULT_FLUSH_THRESHOLD = 256 * 1024;
+
+/// default maximum time data waits in memory, in milliseconds
+const int DEFAULT_FLUSH_INTERVAL = 500;
+
+DumpWriter::DumpWriter() :
+    QObject(0),
+    file(0),
+    opened(false),
+    paused(false),
+    format(ConnectDialog::Raw),
+    flush_scheduled(false),
+    flush_threshold(DEFAULT_FLUSH_THRESHOLD),
+    flush_interval(DEFAULT_FLUSH_INTERVAL),
+    sync_policy(SyncOnClose)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    flush_timer = new QTimer(this);
+    connect(flush_timer, &QTimer::timeout, this, &DumpWriter::flush);
+}
+
+DumpWriter::~DumpWriter()
+{
+    delete file;
+}
+
+bool DumpWriter::open(const QString &filename, ConnectDialog::DumpFormat format)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(this, "openFile", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, ok),
+                              Q_ARG(QString, filename), Q_ARG(int, format));
+    return ok;
+}
+
+void DumpWriter::close()
+{
+    QMetaObject::invokeMethod(this, "closeFile", Qt::BlockingQueuedConnection);
+}
+
+void DumpWriter::write(const QByteArray &data, qint64 timestamp, CaptureRecordType type)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!opened || paused)
+        return;
+
+    if (format == ConnectDialog::Capture)
+        capture.append(&pending, type, timestamp, data.constData(), data.size());
+    else if (type == CaptureReceived)
+        pending.append(data);
+
+    // wake up the writer thread only once per batch
+    if (pending.size() >= flush_threshold && !flush_scheduled)
+    {
+        flush_scheduled = true;
+        QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+    }
+}
+
+void DumpWriter::setPaused(bool pause)
+{
+    QMutexLocker locker(&mutex);
+    paused = pause;
+}
+
+void DumpWriter::setFlushThreshold(int bytes)
+{
+    flush_threshold = bytes;
+}
+
+void DumpWriter::setFlushInterval(int msecs)
+{
+    flush_interval = msecs;
+}
+
+void DumpWriter::setSyncPolicy(SyncPolicy policy)
+{
+    sync_policy = policy;
+}
+
+bool DumpWriter::isOpen() const
+{
+    QMutexLocker locker(&mutex);
+    return opened;
+}
+
+DumpWriter::Statistics DumpWriter::statistics() const
+{
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+bool DumpWriter::openFile(const QString &filename, int dump_format)
+{
+    closeFile();
+
+    // mode is OR'ed with 'Text' flag in "Ascii" mode
+    QIODevice::OpenMode mode = QIODevice::Append;
+    if (dump_format == ConnectDialog::Ascii)
+        mode |= QIODevice::Text;
+    else if (dump_format == ConnectDialog::Capture)
+        mode = QIODevice::WriteOnly | QIODevice::Truncate;
+
+    file = new QFile(filename);
+    if (!file->open(mode))
+    {
+        delete file;
+        file = 0;
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        pending.clear();
+        pending.reserve(flush_threshold);
+        flush_scheduled = false;
+        paused = false;
+        memset(&stats, 0, sizeof(stats));
+        format = static_cast<ConnectDialog::DumpFormat>(dump_format);
+        if (format == ConnectDialog::Capture)
+            capture.begin(&pending, ChunkRing::timestamp());
+        opened = true;
+    }
+
+    flush_timer->start(flush_interval);
+    return true;
+}
+
+void DumpWriter::closeFile()
+{
+    if (!file)
+        return;
+
+    {
+        // from now on, write() drops data
+        QMutexLocker locker(&mutex);
+        opened = false;
+        if (format == ConnectDialog::Capture)
+            capture.end(&pending, ChunkRing::timestamp());
+    }
+
+    flush_timer->stop();
+    flush();
+
+    if (sync_policy != NoSync)
+        sync();
+
+    file->close();
+    delete file;
+    file = 0;
+}
+
+void DumpWriter::flush()
+{
+    QByteArray batch;
+    {
+        QMutexLocker locker(&mutex);
+        flush_scheduled = false;
+
+        // keep a buffer of the same capacity for next batch
+        batch.reserve(flush_threshold);
+        pending.swap(batch);
+    }
+
+    if (!file || batch.isEmpty())
+        return;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    const qint64 written = file->write(batch);
+    file->flush();
+    if (sync_policy == SyncOnFlush)
+        sync();
+
+    const qint64 usecs = elapsed.nsecsElapsed() / 1000;
+
+    QMutexLocker locker(&mutex);
+    if (written > 0)
+        stats.bytes_written += written;
+    ++stats.flush_count;
+    stats.last_flush_usecs = usecs;
+    stats.total_flush_usecs += usecs;
+    stats.max_flush_usecs = qMax(stats.max_flush_usecs, usecs);
+}
+
+void DumpWriter::sync()
+{
+    file->flush();
+#ifdef Q_OS_WIN
+    _commit(file->handle());
+#else
+    fsync(file->handle());
+#endif
+}
@@ -0,0 +1,202 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief DumpWriter class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef DUMPWRITER_H
+#define DUMPWRITER_H
+
+#include "capturefile.h"
+#include "connectdialog.h"
+
+#include <QObject>
+#include <QMutex>
+
+class QFile;
+class QTimer;
+
+/**
+ * \brief write session dump file from a background thread
+ *
+ * the dump file is kept opened for the whole session, data passed to
+ * write() is only appended to an in-memory batch, which is written to
+ * disk by the writer thread once it is big enough or old enough.
+ *
+ * in Raw and Ascii formats, only received data is dumped. In Capture format
+ * both directions are dumped, with their timestamps (see capturefile.h)
+ *
+ * write(), setPaused() and statistics() are thread-safe, the other methods are meant to
+ * be called from the thread that created the writer thread. Settings are
+ * taken into account at next open().
+ *
+ * \note the instance must be moved to its own thread before calling open()
+ */
+class DumpWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * \brief when to ask the OS to commit written data to the disk
+     */
+    enum SyncPolicy
+    {
+        NoSync      = 0,    /// never, let the OS decide
+        SyncOnClose = 1,    /// when dump file is closed
+        SyncOnFlush = 2     /// after each batch written
+    };
+
+    /**
+     * \brief dump writer counters
+     */
+    struct Statistics
+    {
+        /// bytes written to the dump file
+        qint64 bytes_written;
+
+        /// number of batches written
+        qint64 flush_count;
+
+        /// duration of the last flush, in microseconds
+        qint64 last_flush_usecs;
+
+        /// longest flush duration, in microseconds
+        qint64 max_flush_usecs;
+
+        /// cumulated flush duration, in microseconds
+        qint64 total_flush_usecs;
+    };
+
+private:
+
+    /// dump file, only accessed from the writer thread
+    QFile       *file;
+
+    /// periodic flush timer
+    QTimer      *flush_timer;
+
+    /// protects opened, paused, pending, flush_scheduled and stats
+    mutable QMutex mutex;
+
+    /// indicate that write() calls are accepted
+    bool        opened;
+
+    /// indicate that write() calls are ignored, see setPaused()
+    bool        paused;
+
+    /// format of current dump file
+    ConnectDialog::DumpFormat format;
+
+    /// capture stream encoder, used in Capture format
+    CaptureWriter capture;
+
+    /// data waiting to be written
+    QByteArray  pending;
+
+    /// indicate that a flush has been requested to the writer thread
+    bool        flush_scheduled;
+
+    /// writer counters
+    Statistics  stats;
+
+    /// pending size triggering a flush
+    int         flush_threshold;
+
+    /// maximum time data stays in memory, in milliseconds
+    int         flush_interval;
+
+    /// current sync policy
+    SyncPolicy  sync_policy;
+
+public:
+
+    DumpWriter();
+    ~DumpWriter();
+
+    /**
+     * \brief open dump file and reset counters
+     *
+     * Raw and Ascii dumps are appended to existing file, Ascii being opened
+     * in text mode (end of lines translation). Capture dumps overwrite it.
+     *
+     * \param filename  dump file path
+     * \param format    dump file format
+     * \return false if the file can't be opened
+     */
+    bool open(const QString &filename, ConnectDialog::DumpFormat format);
+
+    /**
+     * \brief write pending data and close dump file
+     */
+    void close();
+
+    /**
+     * \brief return true if dump file is opened
+     */
+    bool isOpen() const;
+
+    /**
+     * \brief queue data to be written
+     * \note data is dropped if dump file is not opened or writing is paused
+     * \param data      byte array data
+     * \param timestamp data timestamp, see ChunkRing::timestamp()
+     * \param type      data direction
+     */
+    void write(const QByteArray &data, qint64 timestamp, CaptureRecordType type);
+
+    /**
+     * \brief suspend or resume writing, open() resumes it
+     */
+    void setPaused(bool pause);
+
+    /**
+     * \brief set the amount of pending data triggering a flush
+     */
+    void setFlushThreshold(int bytes);
+
+    /**
+     * \brief set maximum time data waits in memory before being written
+     */
+    void setFlushInterval(int msecs);
+
+    /**
+     * \brief set sync policy
+     */
+    void setSyncPolicy(SyncPolicy policy);
+
+    /**
+     * \brief return a copy of current counters
+     */
+    Statistics statistics() const;
+
+private:
+
+    /**
+     * \brief open dump file, in writer thread
+     */
+    Q_INVOKABLE bool openFile(const QString &filename, int format);
+
+    /**
+     * \brief flush and close dump file, in writer thread
+     */
+    Q_INVOKABLE void closeFile();
+
+    /**
+     * \brief write pending data to the dump file, in writer thread
+     */
+    Q_INVOKABLE void flush();
+
+    /**
+     * \brief commit written data to the disk
+     */
+    void sync();
+};
+
+#endif // DUMPWRITER_H
@@ -13,51 +13,475 @@
 #include <QApplication>
 #include <QtSerialPort>
 #include <QFile>
+#include <QFileInfo>
 
-FileTransfer::FileTransfer(QObject *parent, QSerialPort *serial, const QString &filename) :
+/// size of the buffer of received data, memory use doesn't depend on file size
+const int OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+/// time given to the serial port to write some pending data
+const int DRAIN_TIMEOUT_MS = 10000;
+
+/// minimum time between two transferMeasured signals
+const int MEASURE_INTERVAL_MS = 250;
+
+/// size of the buffer of statistics lines
+const int STATS_BUFFER_SIZE = 16 * 1024;
+
+/// statistics file column names
+const char STATS_COLUMNS[] = "offset,length,time_ms,rtt_ms,outcome,resent\n";
+
+/**
+ * \brief return the statistics file name of a block outcome
+ */
+static const char *outcomeName(FileTransfer::BlockOutcome outcome)
+{
+    switch (outcome)
+    {
+        case FileTransfer::BlockAcked:
+            return "ack";
+        case FileTransfer::BlockRejected:
+            return "nak";
+        case FileTransfer::BlockCancelled:
+            return "can";
+        case FileTransfer::BlockTimedOut:
+            return "timeout";
+        case FileTransfer::BlockStreamed:
+            return "stream";
+        case FileTransfer::BlockReceived:
+            return "recv";
+        case FileTransfer::BlockDuplicate:
+        default:
+            return "dup";
+    }
+}
+
+/**
+ * \brief return the line throughput allowed by serial port settings
+ */
+static qint64 lineBytesPerSec(const QSerialPort *serial)
+{
+    // start bit, data bits, parity bit and stop bits, in half bits
+    const int data_bits = serial->dataBits() > 0 ? serial->dataBits() : 8;
+    int half_bits = 2 * (1 + data_bits);
+    if (serial->parity() != QSerialPort::NoParity)
+        half_bits += 2;
+    switch (serial->stopBits())
+    {
+        case QSerialPort::OneAndHalfStop:
+            half_bits += 3;
+            break;
+        case QSerialPort::TwoStop:
+            half_bits += 4;
+            break;
+        default:
+            half_bits += 2;
+            break;
+    }
+
+    return qMax<qint64>(serial->baudRate(), 0) * 2 / half_bits;
+}
+
+FileTransfer::FileTransfer(QObject *parent, QSerialPort *serial, const QString &filename,
+                           Direction direction) :
     QObject(parent),
     filename(filename),
+    direction(direction),
+    following(false),
     serial(serial),
-    thread(0)
+    input(serial),
+    thread(0),
+    last_progress(0),
+    sent_end(0)
 {
     total_size = 0;
+    stats.bytes = 0;
+    stats.elapsed_msecs = 0;
+    stats.retries = 0;
+    stats.duplicates = 0;
+    stats.blocks = 0;
+    stats.block_bytes = 0;
+    stats.naks = 0;
+    stats.cancels = 0;
+    stats.timeouts = 0;
+    stats.rtt_count = 0;
+    stats.rtt_last_usecs = 0;
+    stats.rtt_min_usecs = 0;
+    stats.rtt_max_usecs = 0;
+    stats.rtt_total_usecs = 0;
+    stats.line_bytes_per_sec = 0;
     qRegisterMetaType<TransferError>("TransferError");
+    qRegisterMetaType<FileTransfer::Statistics>("FileTransfer::Statistics");
 }
 
 bool FileTransfer::startTransfer()
 {   
-    // fill buffer with file content
-    QFile file(filename);
-    if (file.open(QIODevice::ReadOnly))
-    {
-        buffer = file.readAll();
-        total_size = file.size();
-        file.close();
-        if (total_size > 0)
+    bool ready = false;
+    TransferError error = InputFileError;
+
+    if (direction == Receive)
+    {
+        // received data is streamed to the file
+        output.setFileName(filename);
+        ready = output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        output_buffer.reserve(OUTPUT_BUFFER_SIZE);
+        error = OutputFileError;
+    }
+    else
+    {
+        // the file is opened and read from the transfer thread, an empty
+        // regular file can be rejected right now though
+        const QFileInfo info(filename);
+        ready = info.isReadable() && !info.isDir() && (!info.isFile() || info.size() > 0 || following);
+    }
+
+    if (ready)
+    {
+        // statistics are optional, the transfer goes on without them
+        if (!stats_filename.isEmpty())
         {
-            thread = new QThread;
+            stats_file.setFileName(stats_filename);
+            if (stats_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                stats_buffer.reserve(STATS_BUFFER_SIZE);
+                stats_buffer.append(QStringLiteral("# %1 %2 %3\n")
+                    .arg(metaObject()->className())
+                    .arg(direction == Send ? QStringLiteral("send") : QStringLiteral("receive"))
+                    .arg(serial->portName()).toUtf8());
+                stats_buffer.append(STATS_COLUMNS);
+            }
+            else
+            {
+                qWarning("can't write transfer statistics to %s", qPrintable(stats_filename));
+            }
+        }
 
-            // and move both serialport and filetransfer (this) instance
-            moveToThread(thread);
-            serial->moveToThread(thread);
+        stats.line_bytes_per_sec = lineBytesPerSec(serial);
+        input.clear();
+        elapsed.start();
 
-            // call child class performTransfer() when thread starts
-            connect(thread, &QThread::started, this, &FileTransfer::performTransfer);
+        thread = new QThread;
 
-            connect(this, &FileTransfer::transferEnded,
-                    this, &FileTransfer::handleTransferEnded);
+        // and move both serialport and filetransfer (this) instance
+        moveToThread(thread);
+        serial->moveToThread(thread);
 
-            connect(thread, &QThread::finished, thread, &QThread::deleteLater);
+        // call child class performTransfer() when thread starts
+        connect(thread, &QThread::started, this, &FileTransfer::run);
 
-            thread->start();
-            return true;
-        }
+        connect(this, &FileTransfer::transferEnded,
+                this, &FileTransfer::handleTransferEnded);
+
+        connect(thread, &QThread::finished, thread, &QThread::deleteLater);
+
+        thread->start();
+        return true;
     }
 
-    handleTransferEnded(InputFileError);
+    handleTransferEnded(error);
+
+    // no thread will end the transfer, do it now
+    emit transferEnded(error);
     return false;
 }
 
+void FileTransfer::setFollow(int idle_msecs)
+{
+    following = idle_msecs > 0;
+    source.setFollow(idle_msecs);
+}
+
+void FileTransfer::setStatsFile(const QString &filename)
+{
+    stats_filename = filename;
+}
+
+void FileTransfer::run()
+{
+    if (direction == Send)
+    {
+        if (!openSource(filename))
+        {
+            finishTransfer(InputFileError);
+            return;
+        }
+    }
+    else
+    {
+        beginFile(filename);
+    }
+
+    performTransfer();
+}
+
+bool FileTransfer::openSource(const QString &name)
+{
+    if (!source.open(name))
+        return false;
+
+    total_size = source.size();
+    last_progress = 0;
+    beginFile(name);
+    return true;
+}
+
+void FileTransfer::reportProgress(qint64 done)
+{
+    // no percentage without a known size
+    if (total_size <= 0)
+        return;
+
+    const int cur_progress = 100 * qMin(done, total_size) / total_size;
+    if (cur_progress > last_progress)
+    {
+        last_progress = cur_progress;
+        emit transferProgressed(cur_progress);
+    }
+}
+
+FileTransfer::TransferError FileTransfer::sendBatch(const QStringList &filenames)
+{
+    TransferError error = beginBatch();
+
+    for (int i = 0; i < filenames.size() && error == NoError; ++i)
+    {
+        // the first file has been opened by run()
+        if (i > 0 && !openSource(filenames.at(i)))
+        {
+            cancel();
+            return InputFileError;
+        }
+
+        error = sendBatchFile(filenames.at(i));
+    }
+
+    if (error == NoError)
+        error = endBatch();
+
+    return error;
+}
+
+FileTransfer::TransferError FileTransfer::beginBatch()
+{
+    return NoError;
+}
+
+FileTransfer::TransferError FileTransfer::sendBatchFile(const QString &name)
+{
+    Q_UNUSED(name)
+    return UnsupportedError;
+}
+
+FileTransfer::TransferError FileTransfer::endBatch()
+{
+    return NoError;
+}
+
+void FileTransfer::cancel()
+{
+}
+
+FileTransfer::Statistics FileTransfer::statistics() const
+{
+    return stats;
+}
+
+void FileTransfer::finishTransfer(TransferError error)
+{
+    // before emitting, statistics are read as soon as transferEnded is received
+    stats.elapsed_msecs = elapsed.elapsed();
+    if (output.isOpen())
+        output.close();
+    source.close();
+    closeStatsFile(error);
+
+    emit transferEnded(error);
+}
+
+bool FileTransfer::writeOutput(const char *data, int len)
+{
+    if (output_buffer.size() + len > OUTPUT_BUFFER_SIZE && !flushOutput())
+        return false;
+
+    output_buffer.append(data, len);
+    stats.bytes += len;
+    return true;
+}
+
+bool FileTransfer::flushOutput()
+{
+    const bool ok = output.write(output_buffer) == output_buffer.size();
+    output_buffer.clear();
+    return ok;
+}
+
+bool FileTransfer::drainOutput(qint64 limit)
+{
+    while (serial->bytesToWrite() > limit)
+    {
+        if (!serial->waitForBytesWritten(DRAIN_TIMEOUT_MS))
+            return false;
+    }
+    return true;
+}
+
+void FileTransfer::beginFile(const QString &name)
+{
+    // blocks of the previous file won't get a reply anymore
+    pending_blocks.clear();
+    sent_end = 0;
+
+    if (stats_file.isOpen())
+        stats_buffer.append(QStringLiteral("# file %1\n").arg(name).toUtf8());
+}
+
+void FileTransfer::blockSent(qint64 offset, int len, bool wait_reply)
+{
+    const qint64 now_usecs = elapsed.nsecsElapsed() / 1000;
+
+    // only the part never sent before is new data
+    const bool resent = offset < sent_end;
+    if (offset + len > sent_end)
+    {
+        stats.block_bytes += offset + len - qMax(offset, sent_end);
+        sent_end = offset + len;
+    }
+    ++stats.blocks;
+
+    if (wait_reply)
+    {
+        const PendingBlock block = { offset, len, now_usecs, resent };
+        pending_blocks.append(block);
+    }
+    else
+    {
+        logBlock(offset, len, now_usecs, -1, BlockStreamed, resent);
+    }
+
+    reportMeasures();
+}
+
+void FileTransfer::blockReplied(BlockOutcome outcome, qint64 pos)
+{
+    const qint64 now_usecs = elapsed.nsecsElapsed() / 1000;
+
+    switch (outcome)
+    {
+        case BlockRejected:
+            ++stats.naks;
+            break;
+        case BlockCancelled:
+            ++stats.cancels;
+            break;
+        case BlockTimedOut:
+            ++stats.timeouts;
+            break;
+        default:
+            break;
+    }
+
+    while (!pending_blocks.isEmpty())
+    {
+        const PendingBlock block = pending_blocks.first();
+        if (outcome == BlockAcked && pos >= 0 && block.offset + block.len > pos)
+            break;
+        pending_blocks.removeFirst();
+
+        const qint64 rtt_usecs = now_usecs - block.sent_usecs;
+        if (outcome == BlockAcked)
+        {
+            stats.rtt_last_usecs = rtt_usecs;
+            stats.rtt_min_usecs = stats.rtt_count > 0 ? qMin(stats.rtt_min_usecs, rtt_usecs) : rtt_usecs;
+            stats.rtt_max_usecs = qMax(stats.rtt_max_usecs, rtt_usecs);
+            stats.rtt_total_usecs += rtt_usecs;
+            ++stats.rtt_count;
+        }
+
+        logBlock(block.offset, block.len, block.sent_usecs, rtt_usecs, outcome, block.resent);
+    }
+
+    reportMeasures();
+}
+
+void FileTransfer::blockReceived(qint64 offset, int len, BlockOutcome outcome)
+{
+    ++stats.blocks;
+    if (outcome == BlockReceived)
+        stats.block_bytes += len;
+    else if (outcome == BlockRejected)
+        ++stats.naks;
+
+    logBlock(offset, len, elapsed.nsecsElapsed() / 1000, -1, outcome, outcome == BlockDuplicate);
+    reportMeasures();
+}
+
+void FileTransfer::logBlock(qint64 offset, int len, qint64 time_usecs, qint64 rtt_usecs,
+                            BlockOutcome outcome, bool resent)
+{
+    if (!stats_file.isOpen())
+        return;
+
+    stats_buffer.append(QByteArray::number(offset));
+    stats_buffer.append(',');
+    stats_buffer.append(QByteArray::number(len));
+    stats_buffer.append(',');
+    stats_buffer.append(QByteArray::number(time_usecs / 1000.0, 'f', 3));
+    stats_buffer.append(',');
+    if (rtt_usecs >= 0)
+        stats_buffer.append(QByteArray::number(rtt_usecs / 1000.0, 'f', 3));
+    stats_buffer.append(',');
+    stats_buffer.append(outcomeName(outcome));
+    stats_buffer.append(resent ? ",1\n" : ",0\n");
+
+    if (stats_buffer.size() >= STATS_BUFFER_SIZE)
+    {
+        stats_file.write(stats_buffer);
+        stats_buffer.clear();
+    }
+}
+
+void FileTransfer::reportMeasures()
+{
+    if (measure_timer.isValid() && measure_timer.elapsed() < MEASURE_INTERVAL_MS)
+        return;
+    measure_timer.start();
+
+    stats.elapsed_msecs = elapsed.elapsed();
+    emit transferMeasured(stats);
+}
+
+void FileTransfer::closeStatsFile(TransferError error)
+{
+    if (!stats_file.isOpen())
+        return;
+
+    const qint64 msecs = qMax<qint64>(stats.elapsed_msecs, 1);
+    stats_buffer.append(QStringLiteral(
+        "# result %1\n"
+        "# bytes %2\n"
+        "# seconds %3\n"
+        "# throughput_bytes_per_s %4\n"
+        "# line_bytes_per_s %5\n"
+        "# blocks %6\n"
+        "# retries %7\n"
+        "# duplicates %8\n"
+        "# naks %9\n")
+        .arg(errorString(error)).arg(stats.bytes).arg(msecs / 1000.0, 0, 'f', 3)
+        .arg(stats.bytes * 1000 / msecs).arg(stats.line_bytes_per_sec)
+        .arg(stats.blocks).arg(stats.retries).arg(stats.duplicates).arg(stats.naks).toUtf8());
+    stats_buffer.append(QStringLiteral(
+        "# cancels %1\n"
+        "# timeouts %2\n"
+        "# rtt_ms min %3 avg %4 max %5\n")
+        .arg(stats.cancels).arg(stats.timeouts)
+        .arg(stats.rtt_min_usecs / 1000.0, 0, 'f', 3)
+        .arg(stats.rtt_total_usecs / 1000.0 / qMax(stats.rtt_count, 1), 0, 'f', 3)
+        .arg(stats.rtt_max_usecs / 1000.0, 0, 'f', 3).toUtf8());
+
+    stats_file.write(stats_buffer);
+    stats_buffer.clear();
+    stats_file.close();
+}
+
 void FileTransfer::handleTransferEnded(TransferError error)
 {
     Q_UNUSED(error)
@@ -67,7 +491,8 @@ void FileTransfer::handleTransferEnded(TransferError error)
     moveToThread(QApplication::instance()->thread());
 
     // ... we can end the thread
-    thread->quit();
+    if (thread)
+        thread->quit();
 }
 
 QString FileTransfer::errorString(TransferError error)
@@ -89,6 +514,10 @@ QString FileTransfer::errorString(TransferError error)
             return QStringLiteral("Transfer cancelled");
         case InputFileError:
             return QStringLiteral("Can't open input file");
+        case OutputFileError:
+            return QStringLiteral("Can't write output file");
+        case UnsupportedError:
+            return QStringLiteral("Not supported by this protocol");
         case UnknownError:
         default:
             return QStringLiteral("Unknown Error");
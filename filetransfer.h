@@ -13,6 +13,13 @@
 #define FILETRANSFER_H
 
 #include <QObject>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+
+#include "transferinput.h"
+#include "transfersource.h"
 
 class QSerialPort;
 
@@ -23,14 +30,25 @@ class QSerialPort;
  * implement this pure virtual method :
  *
  *  - TransferError performTransfer() : this is where the actual file
- *      transfer must take place. At this point 'buffer' and
- *      'total_size' have been set
+ *      transfer must take place. When sending, at this point 'source'
+ *      is open and 'total_size' has been set. When receiving, the output file
+ *      is open and received data is written with writeOutput(). Data
+ *      coming from the serial port should be read through 'input'
+ *
+ *  Once done, child class implementation must call finishTransfer().
+ *
+ *  Furthermore, child class implementation must call reportProgress()
+ *  frequently enough, so that the application can inform the user
+ *  about the current state of the transfer through transferProgressed()
+ *
+ *  batch protocols send their files with sendBatch(), which opens each file
+ *  and calls beginBatch(), sendBatchFile() and endBatch(): subclasses only
+ *  implement the protocol framing
  *
- *  Furthermore, child class implementation must emit transferProgressed()
- *  signal frequently enough, so that the application can inform the user
- *  about the current state of the transfer. the integer parameter of
- *  transferProgressed() should represents the percentage of current
- *  transfer that has already been performed
+ *  blocks are measured as they go, through blockSent() and blockReplied()
+ *  when sending, blockReceived() when receiving: counters are emitted with
+ *  transferMeasured() a few times per second, and each block is written to
+ *  the statistics file, if any
  *
  *  \see FileTransfer::quit_requested
  */
@@ -59,7 +77,91 @@ public:
         /// local file error (size, permission)
         InputFileError           = 6,
         /// unknown error
-        UnknownError             = 7
+        UnknownError             = 7,
+        /// local output file error (permission, disk full)
+        OutputFileError          = 8,
+        /// protocol can't transfer in the requested direction
+        UnsupportedError         = 9
+    };
+
+    /**
+     * \brief transfer direction
+     */
+    enum Direction
+    {
+        /// send a file to the remote
+        Send    = 0,
+        /// receive a file from the remote
+        Receive = 1
+    };
+
+    /**
+     * \brief transfer counters, complete once transferEnded has been emitted
+     */
+    struct Statistics
+    {
+        /// file bytes sent and acknowledged, or received and written
+        qint64 bytes;
+
+        /// transfer duration, in milliseconds
+        qint64 elapsed_msecs;
+
+        /// packets sent again, or received packets rejected
+        int    retries;
+
+        /// received packets that had already been received
+        int    duplicates;
+
+        /// blocks sent, resent ones included, or received
+        int    blocks;
+
+        /// file bytes in blocks sent or accepted so far, updated as the
+        /// transfer goes, unlike bytes for streaming protocols
+        qint64 block_bytes;
+
+        /// negative acknowledgements received, or sent when receiving
+        int    naks;
+
+        /// cancel requests received
+        int    cancels;
+
+        /// replies that didn't come in time
+        int    timeouts;
+
+        /// acknowledgements whose round-trip time was measured
+        int    rtt_count;
+
+        /// round-trip times between sending a block and its
+        /// acknowledgement, in microseconds
+        qint64 rtt_last_usecs;
+        qint64 rtt_min_usecs;
+        qint64 rtt_max_usecs;
+        qint64 rtt_total_usecs;
+
+        /// line throughput allowed by the serial port settings, in bytes per
+        /// second, 0 if unknown
+        qint64 line_bytes_per_sec;
+    };
+
+    /**
+     * \brief what became of a block
+     */
+    enum BlockOutcome
+    {
+        /// acknowledged by the receiver
+        BlockAcked      = 0,
+        /// rejected by the receiver, or rejected when receiving
+        BlockRejected   = 1,
+        /// the receiver asked to cancel
+        BlockCancelled  = 2,
+        /// no reply in time
+        BlockTimedOut   = 3,
+        /// streamed, no reply expected
+        BlockStreamed   = 4,
+        /// received and accepted
+        BlockReceived   = 5,
+        /// received again, already accepted
+        BlockDuplicate  = 6
     };
 
     /**
@@ -71,21 +173,74 @@ public:
 
 protected:
 
-    /// file to transfer
+    /// file to transfer, or to write received data to
     QString      filename;
 
+    /// send or receive filename
+    Direction    direction;
+
+    /// set if the file to send is followed as it grows
+    bool         following;
+
     /// serial port instance used for the transfer
     QSerialPort *serial;
 
-    /// full content of file to transfer
-    QByteArray   buffer;
+    /// buffered input from serial
+    TransferInput input;
+
+    /// file to transfer, read block after block
+    TransferSource source;
 
-    /// total size in bytes of buffer
+    /// total size in bytes of file to transfer, -1 if unknown
     qint64       total_size;
 
     /// thread in which the transfer is performed
     QThread     *thread;
 
+    /// counters of current transfer
+    Statistics   stats;
+
+    /// measures transfer duration
+    QElapsedTimer elapsed;
+
+private:
+
+    /// file receiving data, when receiving
+    QFile        output;
+
+    /// received data not written to output yet
+    QByteArray   output_buffer;
+
+    /// last transfer percentage emitted for current file
+    int          last_progress;
+
+    /// block sent, waiting for its reply
+    struct PendingBlock
+    {
+        qint64 offset;
+        int    len;
+        qint64 sent_usecs;
+        bool   resent;
+    };
+
+    /// blocks waiting for a reply, oldest first
+    QList<PendingBlock> pending_blocks;
+
+    /// end of the furthest block sent in current file
+    qint64       sent_end;
+
+    /// statistics file name, empty for none
+    QString      stats_filename;
+
+    /// per-block statistics, when a file name is set
+    QFile        stats_file;
+
+    /// statistics lines not written to stats_file yet
+    QByteArray   stats_buffer;
+
+    /// time since counters were last emitted
+    QElapsedTimer measure_timer;
+
 public:
 
     /**
@@ -93,7 +248,8 @@ public:
      * \note this method returns immediately, the actual file transfer
      *  is performed in another thread
      * \see performTransfer
-     * \return boolean indicating wether transfer has started or not
+     * \return boolean indicating wether transfer has started or not, if
+     *  not transferEnded has already been emitted
      */
     bool startTransfer();
 
@@ -104,14 +260,120 @@ public:
      */
     static QString errorString(TransferError error);
 
+    /**
+     * \brief send a growing file, until it has not grown for a while
+     * \param idle_msecs time without growth ending the file, 0 to send
+     *  the file as it is when reached (default)
+     * \note must be called before startTransfer()
+     */
+    void setFollow(int idle_msecs);
+
+    /**
+     * \brief return transfer counters
+     * \note only complete once transferEnded has been emitted
+     */
+    Statistics statistics() const;
+
+    /**
+     * \brief write a line per block to filename, then the transfer counters
+     * \param filename CSV file, empty for none (default)
+     * \note must be called before startTransfer()
+     */
+    void setStatsFile(const QString &filename);
+
 protected:
     /**
      * \brief FileTransfer constructor
-     * \param parent   object taking ownership
-     * \param serial   opened instance of QSerialPort
-     * \param filename file to transfer
+     * \param parent    object taking ownership
+     * \param serial    opened instance of QSerialPort
+     * \param filename  file to transfer, or to write received data to
+     * \param direction send or receive filename
      */
-    FileTransfer(QObject *parent, QSerialPort *serial, const QString &filename);
+    FileTransfer(QObject *parent, QSerialPort *serial, const QString &filename,
+                 Direction direction = Send);
+
+    /**
+     * \brief record transfer duration, close output file and emit transferEnded
+     * \param error transfer end error code
+     */
+    void finishTransfer(TransferError error);
+
+    /**
+     * \brief write received data to the output file, through a fixed-size buffer
+     * \return false on write error
+     */
+    bool writeOutput(const char *data, int len);
+
+    /**
+     * \brief write buffered received data to the output file
+     * \return false on write error
+     */
+    bool flushOutput();
+
+    /**
+     * \brief wait until at most limit bytes are waiting to be written to
+     *  the serial port, so that streamed data doesn't pile up in memory
+     * \return false if the port stopped writing
+     */
+    bool drainOutput(qint64 limit);
+
+    /**
+     * \brief emit transferProgressed if current file progressed of at least 1%
+     * \param done bytes of current file already transferred
+     */
+    void reportProgress(qint64 done);
+
+    /**
+     * \brief send filenames one after the other, the first one being already
+     *  open, see beginBatch(), sendBatchFile() and endBatch()
+     * \return transfer end code
+     */
+    TransferError sendBatch(const QStringList &filenames);
+
+    /**
+     * \brief start a batch, before the first file
+     */
+    virtual TransferError beginBatch();
+
+    /**
+     * \brief send a file of the batch, open in source
+     * \param name file name
+     */
+    virtual TransferError sendBatchFile(const QString &name);
+
+    /**
+     * \brief end a batch, after the last file
+     */
+    virtual TransferError endBatch();
+
+    /**
+     * \brief abort the transfer on the remote side, does nothing by default
+     */
+    virtual void cancel();
+
+    /**
+     * \brief record a block just written to the serial port
+     * \param offset     block offset in current file
+     * \param len        file bytes in the block
+     * \param wait_reply block waiting for a reply, false if streamed
+     */
+    void blockSent(qint64 offset, int len, bool wait_reply = true);
+
+    /**
+     * \brief record a reply of the receiver, ending pending blocks
+     * \param outcome    BlockAcked, BlockRejected, BlockCancelled or BlockTimedOut
+     * \param pos        for BlockAcked, acknowledged position, blocks ending
+     *  after it stay pending. -1 to end all pending blocks
+     */
+    void blockReplied(BlockOutcome outcome, qint64 pos = -1);
+
+    /**
+     * \brief record a block received
+     * \param offset     block offset in received file
+     * \param len        block length, 0 if unknown
+     * \param outcome    BlockReceived, BlockDuplicate or BlockRejected
+     */
+    void blockReceived(qint64 offset, int len, BlockOutcome outcome);
 
 private:
 
@@ -121,12 +383,48 @@ private:
      */
     virtual void performTransfer() = 0;
 
+    /**
+     * \brief open the file to send, in the transfer thread since opening a
+     *  FIFO blocks until its writer shows up, then perform the transfer
+     */
+    void run();
+
     /**
      * \brief handle transferEnded signal
      * \param error transfer end error code
      */
     void handleTransferEnded(TransferError error);
 
+    /**
+     * \brief open a file to send, and reset progress of current file
+     * \return false if the file can't be read
+     */
+    bool openSource(const QString &name);
+
+    /**
+     * \brief start measuring blocks of a new file
+     * \param name file name
+     */
+    void beginFile(const QString &name);
+
+    /**
+     * \brief append a block line to the statistics file
+     * \param rtt_usecs time until the reply, -1 if none
+     */
+    void logBlock(qint64 offset, int len, qint64 time_usecs, qint64 rtt_usecs,
+                  BlockOutcome outcome, bool resent);
+
+    /**
+     * \brief emit transferMeasured, at most every MEASURE_INTERVAL_MS
+     */
+    void reportMeasures();
+
+    /**
+     * \brief write transfer counters at the end of the statistics file, and
+     *  close it
+     */
+    void closeStatsFile(TransferError error);
+
 signals:
     /**
      * \brief signal emitted when file transfer has ended
@@ -140,6 +438,14 @@ signals:
      * \percent percentage of file transfered
      */
     void transferProgressed(int percent);
+
+    /**
+     * \brief signal emitted a few times per second while blocks go
+     * \param stats counters so far
+     */
+    void transferMeasured(FileTransfer::Statistics stats);
 };
 
+Q_DECLARE_METATYPE(FileTransfer::Statistics)
+
 #endif // FILETRANSFER_H
@@ -26,6 +26,7 @@
  */
 
 #include "crc16.h"
+#include "crcclmul.h"
 
 /* CRC16 implementation acording to CCITT standards */
 
@@ -66,10 +67,51 @@ static const unsigned short crc16tab[256]= {
   
 unsigned short crc16_ccitt(const void *buf, int len)
 {
-	register int counter;
-	register unsigned short crc = 0;
+	return crc16_ccitt_update(0, buf, len);
+}
+
+unsigned short crc16_ccitt_update(unsigned short crc, const void *buf, int len)
+{
+	/* picked once, at first use */
+	typedef unsigned short (*crc16_fn)(unsigned short, const void *, int);
+	static const crc16_fn impl = crc_clmul_available() ? crc16_ccitt_clmul : crc16_ccitt_slice8;
+	return impl(crc, buf, len);
+}
+
+unsigned short crc16_ccitt_bytewise(unsigned short crc, const void *buf, int len)
+{
+	int counter;
     const char *cbuf = (const char*)(buf);
 	for( counter = 0; counter < len; counter++)
         crc = (crc<<8) ^ crc16tab[((crc>>8) ^ *cbuf++)&0x00FF];
 	return crc;
 }
+
+/* tables of the contribution of a byte followed by 0 to 7 bytes */
+struct crc16_slices {
+	unsigned short tab[8][256];
+
+	crc16_slices() {
+		for (int i = 0; i < 256; i++) {
+			tab[0][i] = crc16tab[i];
+			for (int k = 1; k < 8; k++)
+				tab[k][i] = (tab[k-1][i]<<8) ^ crc16tab[(tab[k-1][i]>>8)&0x00FF];
+		}
+	}
+};
+
+unsigned short crc16_ccitt_slice8(unsigned short crc, const void *buf, int len)
+{
+	static const crc16_slices slices;
+	const unsigned short (*tab)[256] = slices.tab;
+	const unsigned char *p = (const unsigned char *)buf;
+
+	/* 8 bytes per step, the CRC being merged into the first two */
+	for (; len >= 8; len -= 8, p += 8) {
+		crc = tab[7][p[0] ^ (crc>>8)] ^ tab[6][p[1] ^ (crc&0xFF)] ^
+		      tab[5][p[2]] ^ tab[4][p[3]] ^ tab[3][p[4]] ^
+		      tab[2][p[5]] ^ tab[1][p[6]] ^ tab[0][p[7]];
+	}
+
+	return crc16_ccitt_bytewise(crc, p, len);
+}
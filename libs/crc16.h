@@ -28,6 +28,15 @@
 #ifndef _CRC16_H_
 #define _CRC16_H_
 
+/* CRC-16/CCITT (XModem) of buf, with the fastest implementation available */
 unsigned short crc16_ccitt(const void *buf, int len);
 
+/* same, continuing from the CRC of the previous data */
+unsigned short crc16_ccitt_update(unsigned short crc, const void *buf, int len);
+
+/* individual implementations: byte at a time table lookup (reference),
+ * and 8 bytes at a time through 8 tables */
+unsigned short crc16_ccitt_bytewise(unsigned short crc, const void *buf, int len);
+unsigned short crc16_ccitt_slice8(unsigned short crc, const void *buf, int len);
+
 #endif /* _CRC16_H_ */
@@ -0,0 +1,33 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief CRC-32 (IEEE 802.3, as used by ZModem and zlib)
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+/**
+ * \brief update a CRC-32 with more data, with the fastest implementation
+ *  available
+ * \param crc CRC-32 of the previous data, 0 to start
+ * \param buf data
+ * \param len data length
+ * \return CRC-32 of the previous data followed by buf
+ */
+unsigned int crc32_update(unsigned int crc, const void *buf, int len);
+
+/**
+ * \brief individual implementations of crc32_update(), which picks the
+ *  fastest one: byte at a time table lookup (reference), and 8 bytes at a
+ *  time through 8 tables
+ */
+unsigned int crc32_bytewise(unsigned int crc, const void *buf, int len);
+unsigned int crc32_slice8(unsigned int crc, const void *buf, int len);
+
+#endif /* _CRC32_H_ */
@@ -0,0 +1,210 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief CRC-16/CCITT and CRC-32 folded with carry-less multiplications
+ *
+ * a 128-bit block A·x^64 + B is moved T bits further in the message by
+ * multiplying A by x^(64+T) mod P and B by x^T mod P: both products are
+ * congruent to the block shifted, and short enough to be xored with the
+ * block found T bits later. Folding keeps 4 blocks in flight, 64 bytes
+ * per step, then merges them into one block whose CRC is the CRC of all
+ * the data folded so far.
+ *
+ * CRC-16/CCITT is not reflected: blocks are byte-swapped so that bit i
+ * is the coefficient of x^i. CRC-32 is reflected: bits stay as loaded, the
+ * multiplication of two reflected operands yields the reflected product
+ * shifted by one bit, which the constants make up for.
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "crcclmul.h"
+#include "crc16.h"
+#include "crc32.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_CLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#ifdef CRC_CLMUL
+
+#define CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+/* CRC-16/CCITT and CRC-32 polynomials, leading term implied */
+static const unsigned int CRC16_POLY = 0x1021;
+static const unsigned int CRC32_POLY = 0x04c11db7;
+
+/* x^n mod P, for a polynomial P of given degree */
+static unsigned int xpow_mod(int n, unsigned int poly, int degree)
+{
+	const unsigned int top = 1u << (degree - 1);
+	const unsigned int mask = degree == 32 ? 0xffffffffu : (1u << degree) - 1;
+	unsigned int r = 1;
+	while (n-- > 0) {
+		const bool carry = r & top;
+		r = (r << 1) & mask;
+		if (carry)
+			r ^= poly;
+	}
+	return r;
+}
+
+/* reflect a polynomial of degree < 64 */
+static unsigned long long reflect64(unsigned long long v)
+{
+	unsigned long long r = 0;
+	for (int i = 0; i < 64; i++)
+		if (v & (1ULL << i))
+			r |= 1ULL << (63 - i);
+	return r;
+}
+
+/* folding constants, for the high and low halves of a block: fold by 4
+ * blocks, and by 1 block */
+struct clmul_constants {
+	long long crc16_512[2];
+	long long crc16_128[2];
+	long long crc32_512[2];
+	long long crc32_128[2];
+
+	clmul_constants() {
+		crc16_512[1] = xpow_mod(64 + 512, CRC16_POLY, 16);
+		crc16_512[0] = xpow_mod(512, CRC16_POLY, 16);
+		crc16_128[1] = xpow_mod(64 + 128, CRC16_POLY, 16);
+		crc16_128[0] = xpow_mod(128, CRC16_POLY, 16);
+
+		/* reflected: the low half holds the high degree terms */
+		crc32_512[0] = reflect64(xpow_mod(64 + 512 - 1, CRC32_POLY, 32));
+		crc32_512[1] = reflect64(xpow_mod(512 - 1, CRC32_POLY, 32));
+		crc32_128[0] = reflect64(xpow_mod(64 + 128 - 1, CRC32_POLY, 32));
+		crc32_128[1] = reflect64(xpow_mod(128 - 1, CRC32_POLY, 32));
+	}
+};
+
+static const clmul_constants &constants()
+{
+	static const clmul_constants k;
+	return k;
+}
+
+static CLMUL_TARGET inline __m128i fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+/* fold len bytes, len being a multiple of 16 and at least 64, into one block */
+template <bool swap>
+static CLMUL_TARGET inline __m128i fold_blocks(__m128i first, const unsigned char *p, int len,
+                                               const long long k512[2], const long long k128[2])
+{
+	const __m128i order = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i *blocks = (const __m128i *)p;
+
+#define LOAD(i) (swap ? _mm_shuffle_epi8(_mm_loadu_si128(blocks + (i)), order) : _mm_loadu_si128(blocks + (i)))
+
+	__m128i x0 = _mm_xor_si128(LOAD(0), first);
+	__m128i x1 = LOAD(1);
+	__m128i x2 = LOAD(2);
+	__m128i x3 = LOAD(3);
+	blocks += 4;
+	len -= 64;
+
+	const __m128i k4 = _mm_set_epi64x(k512[1], k512[0]);
+	for (; len >= 64; len -= 64, blocks += 4) {
+		x0 = _mm_xor_si128(fold(x0, k4), LOAD(0));
+		x1 = _mm_xor_si128(fold(x1, k4), LOAD(1));
+		x2 = _mm_xor_si128(fold(x2, k4), LOAD(2));
+		x3 = _mm_xor_si128(fold(x3, k4), LOAD(3));
+	}
+
+	const __m128i k1 = _mm_set_epi64x(k128[1], k128[0]);
+	x0 = _mm_xor_si128(fold(x0, k1), x1);
+	x0 = _mm_xor_si128(fold(x0, k1), x2);
+	x0 = _mm_xor_si128(fold(x0, k1), x3);
+
+	for (; len >= 16; len -= 16, blocks++)
+		x0 = _mm_xor_si128(fold(x0, k1), LOAD(0));
+
+#undef LOAD
+
+	return swap ? _mm_shuffle_epi8(x0, order) : x0;
+}
+
+static CLMUL_TARGET unsigned short crc16_fold(unsigned short crc, const unsigned char *p, int len)
+{
+	const clmul_constants &k = constants();
+
+	/* the CRC is merged into the first two bytes */
+	const __m128i first = _mm_set_epi64x((long long)crc << 48, 0);
+	unsigned char folded[16];
+	_mm_storeu_si128((__m128i *)folded, fold_blocks<true>(first, p, len, k.crc16_512, k.crc16_128));
+
+	return crc16_ccitt_slice8(0, folded, 16);
+}
+
+static CLMUL_TARGET unsigned int crc32_fold(unsigned int crc, const unsigned char *p, int len)
+{
+	const clmul_constants &k = constants();
+
+	/* the register, complemented, is merged into the first four bytes */
+	const __m128i first = _mm_cvtsi32_si128(~crc);
+	unsigned char folded[16];
+	_mm_storeu_si128((__m128i *)folded, fold_blocks<false>(first, p, len, k.crc32_512, k.crc32_128));
+
+	return crc32_slice8(0xffffffffu, folded, 16);
+}
+
+int crc_clmul_available(void)
+{
+	static const bool available = [] {
+		unsigned int eax, ebx, ecx, edx;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+	}();
+	return available;
+}
+
+unsigned short crc16_ccitt_clmul(unsigned short crc, const void *buf, int len)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	if (len < 64 || !crc_clmul_available())
+		return crc16_ccitt_slice8(crc, p, len);
+
+	const int folded = len & ~15;
+	crc = crc16_fold(crc, p, folded);
+	return crc16_ccitt_slice8(crc, p + folded, len - folded);
+}
+
+unsigned int crc32_clmul(unsigned int crc, const void *buf, int len)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	if (len < 64 || !crc_clmul_available())
+		return crc32_slice8(crc, p, len);
+
+	const int folded = len & ~15;
+	crc = crc32_fold(crc, p, folded);
+	return crc32_slice8(crc, p + folded, len - folded);
+}
+
+#else /* CRC_CLMUL */
+
+int crc_clmul_available(void)
+{
+	return 0;
+}
+
+unsigned short crc16_ccitt_clmul(unsigned short crc, const void *buf, int len)
+{
+	return crc16_ccitt_slice8(crc, buf, len);
+}
+
+unsigned int crc32_clmul(unsigned int crc, const void *buf, int len)
+{
+	return crc32_slice8(crc, buf, len);
+}
+
+#endif /* CRC_CLMUL */
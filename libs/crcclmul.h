@@ -0,0 +1,35 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief CRC-16/CCITT and CRC-32 folded with carry-less multiplications
+ *
+ * 64 bytes are folded per step with PCLMULQDQ, the remaining 16 bytes and
+ * the tail go through the slice-by-8 tables. Short buffers, and CPUs or
+ * compilers without PCLMULQDQ, use slice-by-8 only.
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef _CRCCLMUL_H_
+#define _CRCCLMUL_H_
+
+/**
+ * \brief return non zero if this CPU has PCLMULQDQ and SSSE3, and the
+ *  carry-less multiply kernels were compiled in
+ */
+int crc_clmul_available(void);
+
+/**
+ * \brief same as crc16_ccitt_update(), folded with carry-less multiplications
+ */
+unsigned short crc16_ccitt_clmul(unsigned short crc, const void *buf, int len);
+
+/**
+ * \brief same as crc32_update(), folded with carry-less multiplications
+ */
+unsigned int crc32_clmul(unsigned int crc, const void *buf, int len);
+
+#endif /* _CRCCLMUL_H_ */
@@ -26,14 +26,14 @@
  */
 
 /* this code needs standard functions memcpy() and memset()
-   and input/output functions _inbyte() and _outbyte().
+   and input/output callbacks, see struct XModemIO in xmodem.h.
 
-   the prototypes of the input/output functions are:
-     int _inbyte(unsigned short timeout); // msec timeout
-     void _outbyte(int c);
+   all transfer state lives in the callbacks context and on the stack,
+   several transfers may run concurrently in different threads.
 
  */
 
+#include "xmodem.h"
 #include "crc16.h"
 #include "string.h"
 
@@ -49,8 +49,36 @@
 #define MAXRETRANS 25
 #define TRANSMIT_XMODEM_1K
 
-extern int _inbyte(unsigned short timeout); // msec timeout
-extern void _outbyte(int c);
+static int _inbyte(const struct XModemIO *io, unsigned short timeout)
+{
+	return io->inbyte(io->context, timeout);
+}
+
+static int _inbuf(const struct XModemIO *io, unsigned char *buf, int len, unsigned short timeout)
+{
+	return io->inbuf(io->context, buf, len, timeout);
+}
+
+static void _outbyte(const struct XModemIO *io, int c)
+{
+	unsigned char b = c;
+	io->outbuf(io->context, &b, 1);
+}
+
+static void _outbuf(const struct XModemIO *io, const unsigned char *buf, int len)
+{
+	io->outbuf(io->context, buf, len);
+}
+
+static void _progress(const struct XModemIO *io, int len)
+{
+	io->progress(io->context, len);
+}
+
+static void _event(const struct XModemIO *io, int event)
+{
+	io->event(io->context, event);
+}
 
 static int check(int crc, const unsigned char *buf, int sz)
 {
@@ -73,26 +101,30 @@ static int check(int crc, const unsigned char *buf, int sz)
 	return 0;
 }
 
-static void flushinput(void)
+static void flushinput(const struct XModemIO *io)
 {
-	while (_inbyte(((DLY_1S)*3)>>1) >= 0)
-		;
+	io->inflush(io->context, ((DLY_1S)*3)>>1);
 }
 
-int xmodemReceive(unsigned char *dest, int destsz)
+int xmodemReceive(const struct XModemIO *io, volatile bool *quit_asap)
 {
 	unsigned char xbuff[1030]; /* 1024 for XModem 1k + 3 head chars + 2 crc + nul */
 	unsigned char *p;
 	int bufsz, crc = 0;
 	unsigned char trychar = 'C';
 	unsigned char packetno = 1;
-	int i, c, len = 0;
+	int i, c;
 	int retry, retrans = MAXRETRANS;
 
 	for(;;) {
 		for( retry = 0; retry < 16; ++retry) {
-			if (trychar) _outbyte(trychar);
-			if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
+
+			// quit before next packet
+			if (*quit_asap)
+				break;
+
+			if (trychar) _outbyte(io, trychar);
+			if ((c = _inbyte(io, (DLY_1S)<<1)) >= 0) {
 				switch (c) {
 				case SOH:
 					bufsz = 128;
@@ -101,13 +133,13 @@ int xmodemReceive(unsigned char *dest, int destsz)
 					bufsz = 1024;
 					goto start_recv;
 				case EOT:
-					flushinput();
-					_outbyte(ACK);
-					return len; /* normal end */
+					flushinput(io);
+					_outbyte(io, ACK);
+					return 0; /* normal end */
 				case CAN:
-					if ((c = _inbyte(DLY_1S)) == CAN) {
-						flushinput();
-						_outbyte(ACK);
+					if ((c = _inbyte(io, DLY_1S)) == CAN) {
+						flushinput(io);
+						_outbyte(io, ACK);
 						return -1; /* canceled by remote */
 					}
 					break;
@@ -116,11 +148,13 @@ int xmodemReceive(unsigned char *dest, int destsz)
 				}
 			}
 		}
-		if (trychar == 'C') { trychar = NAK; continue; }
-		flushinput();
-		_outbyte(CAN);
-		_outbyte(CAN);
-		_outbyte(CAN);
+		if (trychar == 'C' && !*quit_asap) { trychar = NAK; continue; }
+		flushinput(io);
+		_outbyte(io, CAN);
+		_outbyte(io, CAN);
+		_outbyte(io, CAN);
+		if (*quit_asap)
+			return -6; /* local cancel */
 		return -2; /* sync error */
 
 	start_recv:
@@ -128,41 +162,44 @@ int xmodemReceive(unsigned char *dest, int destsz)
 		trychar = 0;
 		p = xbuff;
 		*p++ = c;
-		for (i = 0;  i < (bufsz+(crc?1:0)+3); ++i) {
-			if ((c = _inbyte(DLY_1S)) < 0) goto reject;
-			*p++ = c;
-		}
+		i = bufsz+(crc?1:0)+3;
+		if (_inbuf(io, p, i, DLY_1S) < i) goto reject;
 
 		if (xbuff[1] == (unsigned char)(~xbuff[2]) && 
 			(xbuff[1] == packetno || xbuff[1] == (unsigned char)packetno-1) &&
 			check(crc, &xbuff[3], bufsz)) {
 			if (xbuff[1] == packetno)	{
-				register int count = destsz - len;
-				if (count > bufsz) count = bufsz;
-				if (count > 0) {
-					memcpy (&dest[len], &xbuff[3], count);
-					len += count;
+				if (io->deliver(io->context, &xbuff[3], bufsz)) {
+					flushinput(io);
+					_outbyte(io, CAN);
+					_outbyte(io, CAN);
+					_outbyte(io, CAN);
+					return -7; /* local write error */
 				}
 				++packetno;
 				retrans = MAXRETRANS+1;
 			}
+			else {
+				_event(io, XMODEM_EVENT_DUPLICATE);
+			}
 			if (--retrans <= 0) {
-				flushinput();
-				_outbyte(CAN);
-				_outbyte(CAN);
-				_outbyte(CAN);
+				flushinput(io);
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
 				return -3; /* too many retry error */
 			}
-			_outbyte(ACK);
+			_outbyte(io, ACK);
 			continue;
 		}
 	reject:
-		flushinput();
-		_outbyte(NAK);
+		_event(io, XMODEM_EVENT_RETRY);
+		flushinput(io);
+		_outbyte(io, NAK);
 	}
 }
 
-int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
+int xmodemTransmit(const struct XModemIO *io, volatile bool *quit_asap)
 {
 	unsigned char xbuff[1030]; /* 1024 for XModem 1k + 3 head chars + 2 crc + nul */
 	int bufsz, crc = -1;
@@ -177,7 +214,7 @@ int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
             if (*quit_asap)
 				break;
 
-			if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
+			if ((c = _inbyte(io, (DLY_1S)<<1)) >= 0) {
 				switch (c) {
 				case 'C':
 					crc = 1;
@@ -186,9 +223,9 @@ int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
 					crc = 0;
 					goto start_trans;
 				case CAN:
-					if ((c = _inbyte(DLY_1S)) == CAN) {
-						_outbyte(ACK);
-						flushinput();
+					if ((c = _inbyte(io, DLY_1S)) == CAN) {
+						_outbyte(io, ACK);
+						flushinput(io);
 						return -1; /* canceled by remote */
 					}
 					break;
@@ -197,10 +234,10 @@ int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
 				}
 			}
 		}
-		_outbyte(CAN);
-		_outbyte(CAN);
-		_outbyte(CAN);
-		flushinput();
+		_outbyte(io, CAN);
+		_outbyte(io, CAN);
+		_outbyte(io, CAN);
+		flushinput(io);
         if (*quit_asap)
 			return -6; /* local cancel */
 		return -2; /* no sync */
@@ -214,11 +251,16 @@ int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
 #endif
 			xbuff[1] = packetno;
 			xbuff[2] = ~packetno;
-			c = srcsz - len;
-			if (c > bufsz) c = bufsz;
+			memset (&xbuff[3], 0, bufsz);
+			c = io->fetch(io->context, &xbuff[3], bufsz);
+			if (c < 0) {
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
+				flushinput(io);
+				return -7; /* local read error */
+			}
 			if (c > 0) {
-				memset (&xbuff[3], 0, bufsz);
-				memcpy (&xbuff[3], &src[len], c);
 				if (c < bufsz) xbuff[3+c] = CTRLZ;
 				if (crc) {
 					unsigned short ccrc = crc16_ccitt(&xbuff[3], bufsz);
@@ -235,42 +277,49 @@ int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap)
 				for (retry = 0; retry < MAXRETRANS; ++retry) {
                 if (*quit_asap)
 					break;
-					for (i = 0; i < bufsz+4+(crc?1:0); ++i) {
-						_outbyte(xbuff[i]);
-					}
-					if ((c = _inbyte(DLY_1S)) >= 0 ) {
+					if (retry) _event(io, XMODEM_EVENT_RETRY);
+					_outbuf(io, xbuff, bufsz+4+(crc?1:0));
+					_event(io, XMODEM_EVENT_SENT);
+					if ((c = _inbyte(io, DLY_1S)) >= 0 ) {
 						switch (c) {
 						case ACK:
+							_event(io, XMODEM_EVENT_ACK);
 							++packetno;
 							len += bufsz;
+							_progress(io, len);
 							goto start_trans;
 						case CAN:
-							if ((c = _inbyte(DLY_1S)) == CAN) {
-								_outbyte(ACK);
-								flushinput();
+							_event(io, XMODEM_EVENT_CANCEL);
+							if ((c = _inbyte(io, DLY_1S)) == CAN) {
+								_outbyte(io, ACK);
+								flushinput(io);
 								return -1; /* canceled by remote */
 							}
 							break;
 						case NAK:
 						default:
+							_event(io, XMODEM_EVENT_NAK);
 							break;
 						}
 					}
+					else {
+						_event(io, XMODEM_EVENT_TIMEOUT);
+					}
 				}
-				_outbyte(CAN);
-				_outbyte(CAN);
-				_outbyte(CAN);
-				flushinput();
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
+				_outbyte(io, CAN);
+				flushinput(io);
                 if (*quit_asap)
 					return -6; /* local cancel */
 				return -4; /* xmit error */
 			}
 			else {
 				for (retry = 0; retry < 10; ++retry) {
-					_outbyte(EOT);
-					if ((c = _inbyte((DLY_1S)<<1)) == ACK) break;
+					_outbyte(io, EOT);
+					if ((c = _inbyte(io, (DLY_1S)<<1)) == ACK) break;
 				}
-				flushinput();
+				flushinput(io);
 				return (c == ACK)?len:-5;
 			}
 		}
@@ -15,14 +15,86 @@
 #define XMODEM_H
 
 /**
-* \brief perform xmodem transmission over serial port
-* \param src address of buffer to send over serial port
-* \param srcsz transmit srcsz bytes of src buffer
+* \brief protocol events, reported through XModemIO::event
+*/
+enum XModemEvent
+{
+	/// a packet is sent again, or a received one has been rejected
+	XMODEM_EVENT_RETRY = 0,
+
+	/// an already acknowledged packet has been received again
+	XMODEM_EVENT_DUPLICATE = 1,
+
+	/// a packet has been written, its reply is awaited
+	XMODEM_EVENT_SENT = 2,
+
+	/// the receiver acknowledged the packet
+	XMODEM_EVENT_ACK = 3,
+
+	/// the receiver rejected the packet, or replied with garbage
+	XMODEM_EVENT_NAK = 4,
+
+	/// the receiver replied with a cancel request
+	XMODEM_EVENT_CANCEL = 5,
+
+	/// the receiver didn't reply in time
+	XMODEM_EVENT_TIMEOUT = 6
+};
+
+/**
+* \brief I/O callbacks of a transfer, all of them receive context
+*/
+struct XModemIO
+{
+	/// transfer context, passed to each callback
+	void *context;
+
+	/// consume 1 byte, msec timeout, return consumed byte or -1
+	int (*inbyte)(void *context, unsigned short timeout);
+
+	/// consume len bytes, msec timeout between bytes, return bytes consumed
+	int (*inbuf)(void *context, unsigned char *buf, int len, unsigned short timeout);
+
+	/// discard input until nothing has been received for quiet msec
+	void (*inflush)(void *context, unsigned short quiet);
+
+	/// write len bytes at once
+	void (*outbuf)(void *context, const unsigned char *buf, int len);
+
+	/// len bytes have been acknowledged by the receiver so far
+	void (*progress)(void *context, int len);
+
+	/// a validated packet of len bytes has been received, padding included,
+	/// return non zero to cancel the transfer
+	int (*deliver)(void *context, const unsigned char *buf, int len);
+
+	/// a protocol event occured, see XModemEvent
+	void (*event)(void *context, int event);
+
+	/// read up to len bytes of data to send, return bytes read, less than
+	/// len at the end of data, or -1 on error
+	int (*fetch)(void *context, unsigned char *buf, int len);
+};
+
+/**
+* \brief perform xmodem transmission over serial port, data to send is
+*   pulled from io->fetch packet after packet
+* \param io I/O callbacks of this transfer
 * \param quit_asap if true, the transmission should end as
 *   soon as possible
 * \return error code
 */
-int xmodemTransmit(unsigned char *src, int srcsz, volatile bool *quit_asap);
+int xmodemTransmit(const struct XModemIO *io, volatile bool *quit_asap);
+
+/**
+* \brief perform xmodem reception over serial port, received data is
+*   handed to io->deliver packet after packet
+* \param io I/O callbacks of this transfer
+* \param quit_asap if true, the reception should end as
+*   soon as possible
+* \return 0 on success, or error code
+*/
+int xmodemReceive(const struct XModemIO *io, volatile bool *quit_asap);
 
 #endif // XMODEM_H
 
@@ -0,0 +1,258 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief LineIndex class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "lineindex.h"
+
+#include <QTemporaryFile>
+#include <QDir>
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * \brief return non zero if any byte of word is zero
+ */
+static inline quint64 hasZeroByte(quint64 word)
+{
+    return (word - Q_UINT64_C(0x0101010101010101)) & ~word & Q_UINT64_C(0x8080808080808080);
+}
+
+/**
+ * \brief find next CR or LF char
+ * \return pointer to the char, or end if none
+ */
+static const char *findLineBreak(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    // 16 bytes at a time
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const int mask = _mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+
+    // 8 bytes at a time
+    while (end - p >= 8)
+    {
+        quint64 word;
+        memcpy(&word, p, sizeof(word));
+        if (hasZeroByte(word ^ Q_UINT64_C(0x0D0D0D0D0D0D0D0D)) ||
+                hasZeroByte(word ^ Q_UINT64_C(0x0A0A0A0A0A0A0A0A)))
+            break;
+        p += 8;
+    }
+
+    while (p < end && *p != '\n' && *p != '\r')
+        ++p;
+
+    return p;
+}
+
+LineIndex::LineIndex() :
+    spilled(0),
+    resident_lines(-1),
+    spill_file(0),
+    spill_failed(false),
+    cache_index(-1),
+    line_count(0),
+    indexed_size(0),
+    last_was_cr(false)
+{
+    addLine(0);
+}
+
+LineIndex::~LineIndex()
+{
+    qDeleteAll(blocks);
+    delete spill_file;
+}
+
+void LineIndex::append(const char *data, int len)
+{
+    const char *end = data + len;
+    const char *p = data;
+
+    while ((p = findLineBreak(p, end)) != end)
+    {
+        const qint64 next = indexed_size + (p - data) + 1;
+
+        // the CR of a CR+LF pair already started a line, move its start after the LF
+        const bool after_cr = p > data ? p[-1] == '\r' : last_was_cr;
+        if (*p == '\n' && after_cr)
+            setLineStart(line_count - 1, next);
+        else
+            addLine(next);
+
+        ++p;
+    }
+
+    if (len > 0)
+        last_was_cr = end[-1] == '\r';
+    indexed_size += len;
+}
+
+void LineIndex::clear()
+{
+    qDeleteAll(blocks);
+    blocks.clear();
+    block_bases.clear();
+    far_lines.clear();
+    spilled = 0;
+    spill_failed = false;
+    cache_index = -1;
+    delete spill_file;
+    spill_file = 0;
+    line_count = 0;
+    indexed_size = 0;
+    last_was_cr = false;
+
+    addLine(0);
+}
+
+void LineIndex::setResidentLines(qint64 lines)
+{
+    resident_lines = lines;
+    spillBlocks();
+}
+
+qint64 LineIndex::lineCount() const
+{
+    return line_count;
+}
+
+qint64 LineIndex::lineStart(qint64 line) const
+{
+    const Block *b = block(line / BLOCK_LINES);
+    const quint32 delta = b->deltas[line % BLOCK_LINES];
+    return delta == FAR_LINE ? far_lines.value(line) : b->base + delta;
+}
+
+qint64 LineIndex::lineEnd(qint64 line) const
+{
+    return line + 1 < line_count ? lineStart(line + 1) : indexed_size;
+}
+
+qint64 LineIndex::lineAt(qint64 offset) const
+{
+    // find the block first, so that a single block is read if it is spilled
+    const int index = qMax<int>(0, std::upper_bound(block_bases.constBegin(), block_bases.constEnd(),
+                                                    offset) - block_bases.constBegin() - 1);
+
+    // a CR+LF pair may have moved the first line of the block after its base
+    qint64 low = qint64(index) * BLOCK_LINES;
+    if (low > 0 && lineStart(low) > offset)
+        return low - 1;
+
+    // last line of the block starting at or before offset
+    qint64 high = qMin(line_count, low + BLOCK_LINES) - 1;
+    while (low < high)
+    {
+        const qint64 mid = (low + high + 1) / 2;
+        if (lineStart(mid) <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+const LineIndex::Block *LineIndex::block(int index) const
+{
+    if (index >= spilled)
+        return blocks.at(index);
+
+    if (index != cache_index)
+    {
+        // spilled blocks are stored in order
+        spill_file->seek(qint64(index) * sizeof(Block));
+        spill_file->read(reinterpret_cast<char *>(&cache_block), sizeof(Block));
+        cache_index = index;
+    }
+    return &cache_block;
+}
+
+void LineIndex::spillBlocks()
+{
+    // the last block is still being filled, it always stays in memory
+    while (!spill_failed && resident_lines >= 0 && spilled < blocks.size() - 1 &&
+           line_count - qint64(spilled + 1) * BLOCK_LINES >= resident_lines)
+    {
+        if (!spill_file)
+        {
+            spill_file = new QTemporaryFile(QDir::tempPath() + QStringLiteral("/cutecom-ng-XXXXXX.lines"));
+            if (!spill_file->open())
+            {
+                spill_failed = true;
+                return;
+            }
+        }
+
+        spill_file->seek(qint64(spilled) * sizeof(Block));
+        if (spill_file->write(reinterpret_cast<const char *>(blocks.at(spilled)), sizeof(Block))
+                != qint64(sizeof(Block)))
+        {
+            // keep lines in memory rather than losing them
+            spill_failed = true;
+            return;
+        }
+
+        delete blocks.at(spilled);
+        blocks[spilled] = 0;
+        ++spilled;
+    }
+}
+
+void LineIndex::addLine(qint64 offset)
+{
+    const int index = line_count % BLOCK_LINES;
+    if (index == 0)
+    {
+        Block *block = new Block;
+        block->base = offset;
+        blocks.append(block);
+        block_bases.append(offset);
+    }
+
+    blocks.last()->deltas[index] = 0;
+    setLineStart(line_count++, offset);
+
+    spillBlocks();
+}
+
+void LineIndex::setLineStart(qint64 line, qint64 offset)
+{
+    Block *block = blocks[line / BLOCK_LINES];
+    quint32 &delta = block->deltas[line % BLOCK_LINES];
+
+    if (delta == FAR_LINE)
+        far_lines.remove(line);
+
+    if (offset - block->base < FAR_LINE)
+    {
+        delta = offset - block->base;
+    }
+    else
+    {
+        delta = FAR_LINE;
+        far_lines.insert(line, offset);
+    }
+}
@@ -0,0 +1,165 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief LineIndex class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QVector>
+#include <QHash>
+
+class QTemporaryFile;
+
+/**
+ * \brief offsets of the lines of a byte stream
+ *
+ * the index is fed with the stream as it grows, and gives the offset of
+ * any line in constant time, without scanning the stream again. The last
+ * line may be incomplete, and is extended by further data.
+ *
+ * lines end with CR, LF or CR+LF, a CR+LF pair split between two appends
+ * is a single line end.
+ *
+ * line offsets are stored by blocks of BLOCK_LINES lines: an absolute
+ * offset for the first line of the block, then a 32 bits distance to that
+ * offset for each line, so that an indexed line costs about 4 bytes.
+ *
+ * blocks holding none of the last resident lines are moved to a temporary
+ * file, from which they are transparently read back: memory usage does not
+ * depend on the length of the stream.
+ */
+class LineIndex
+{
+public:
+    /// number of lines per block, power of 2
+    static const int BLOCK_LINES = 1024;
+
+private:
+
+    /// marks a line too far from its block start, see far_lines
+    static const quint32 FAR_LINE = 0xFFFFFFFF;
+
+    /**
+     * \brief offsets of BLOCK_LINES consecutive lines
+     */
+    struct Block
+    {
+        /// offset of first line of the block
+        qint64  base;
+
+        /// offset of each line, relative to base
+        quint32 deltas[BLOCK_LINES];
+    };
+
+    /// blocks of line offsets, all full but the last one, spilled ones are null
+    QVector<Block *>        blocks;
+
+    /// offset of the first line of each block, as the block was created
+    QVector<qint64>         block_bases;
+
+    /// number of blocks spilled to disk, always the oldest ones
+    int                     spilled;
+
+    /// number of most recent lines kept in memory
+    qint64                  resident_lines;
+
+    /// spill file, created when first needed
+    QTemporaryFile          *spill_file;
+
+    /// set if the spill file could not be written, blocks then stay in memory
+    bool                    spill_failed;
+
+    /// last block read back from the spill file
+    mutable int             cache_index;
+
+    /// content of last block read back from the spill file
+    mutable Block           cache_block;
+
+    /// offsets of lines more than 4 GiB away from their block start
+    QHash<qint64, qint64>   far_lines;
+
+    /// number of lines, including the last incomplete one
+    qint64                  line_count;
+
+    /// amount of bytes indexed so far
+    qint64                  indexed_size;
+
+    /// set if last indexed byte is a CR, a LF following it ends no new line
+    bool                    last_was_cr;
+
+    Q_DISABLE_COPY(LineIndex)
+
+public:
+
+    LineIndex();
+    ~LineIndex();
+
+    /**
+     * \brief index data appended to the stream
+     * \param data  appended data
+     * \param len   length of data
+     */
+    void append(const char *data, int len);
+
+    /**
+     * \brief forget all lines
+     */
+    void clear();
+
+    /**
+     * \brief set the number of most recent lines kept in memory, older
+     *  lines are moved to a temporary file
+     */
+    void setResidentLines(qint64 lines);
+
+    /**
+     * \brief return the number of lines, including the last incomplete one
+     */
+    qint64 lineCount() const;
+
+    /**
+     * \brief return the offset of the first byte of a line
+     */
+    qint64 lineStart(qint64 line) const;
+
+    /**
+     * \brief return the offset following a line, end of line chars included
+     */
+    qint64 lineEnd(qint64 line) const;
+
+    /**
+     * \brief return the line holding a given offset
+     */
+    qint64 lineAt(qint64 offset) const;
+
+private:
+
+    /**
+     * \brief return a block, reading it back from the spill file if needed
+     */
+    const Block *block(int index) const;
+
+    /**
+     * \brief move oldest blocks to disk while they hold no resident line
+     */
+    void spillBlocks();
+
+    /**
+     * \brief add a line starting at offset
+     */
+    void addLine(qint64 offset);
+
+    /**
+     * \brief set the start offset of a line
+     */
+    void setLineStart(qint64 line, qint64 offset);
+};
+
+#endif // LINEINDEX_H
@@ -12,12 +12,52 @@
 #include "mainwindow.h"
 #include <QApplication>
 #include <QStyleFactory>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     a.setStyle(QStyleFactory::create("Fusion"));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption refresh_option(QStringLiteral("max-refresh-rate"),
+        QStringLiteral("maximum refresh rate of the output views, in Hz"), QStringLiteral("hz"));
+    parser.addOption(refresh_option);
+    QCommandLineOption memory_option(QStringLiteral("scrollback-memory"),
+        QStringLiteral("memory used to keep received data, in MiB"), QStringLiteral("mib"));
+    parser.addOption(memory_option);
+    QCommandLineOption lines_option(QStringLiteral("scrollback-lines"),
+        QStringLiteral("number of received lines kept in memory, older ones are archived to disk"),
+        QStringLiteral("lines"));
+    parser.addOption(lines_option);
+    QCommandLineOption follow_option(QStringLiteral("transfer-follow"),
+        QStringLiteral("send growing files until they have not grown for this long, in ms"),
+        QStringLiteral("ms"));
+    parser.addOption(follow_option);
+    QCommandLineOption window_option(QStringLiteral("zmodem-window"),
+        QStringLiteral("ZModem data sent ahead of the receiver acknowledgements, in KiB, 0 for no limit"),
+        QStringLiteral("kib"));
+    parser.addOption(window_option);
+    QCommandLineOption stats_option(QStringLiteral("transfer-stats"),
+        QStringLiteral("write per-block statistics of each file transfer to a CSV file in this directory"),
+        QStringLiteral("dir"));
+    parser.addOption(stats_option);
+    parser.process(a);
+
     MainWindow w;
+    if (parser.isSet(refresh_option))
+        w.setMaxRefreshRate(parser.value(refresh_option).toInt());
+    if (parser.isSet(memory_option))
+        w.setScrollbackMemoryLimit(parser.value(memory_option).toLongLong() * 1024 * 1024);
+    if (parser.isSet(lines_option))
+        w.setScrollbackLines(parser.value(lines_option).toLongLong());
+    if (parser.isSet(follow_option))
+        w.setTransferFollow(parser.value(follow_option).toInt());
+    if (parser.isSet(window_option))
+        w.setTransferWindow(parser.value(window_option).toInt() * 1024);
+    if (parser.isSet(stats_option))
+        w.setTransferStatsDir(parser.value(stats_option));
     w.show();
 
     return a.exec();
@@ -9,9 +9,6 @@
  * \author Aurelien Rainone <aurelien@develer.com>
  */
 
-#include <algorithm>
-#include <iterator>
-
 #include <QUiLoader>
 #include <QLineEdit>
 #include <QPropertyAnimation>
@@ -20,39 +17,56 @@
 #include <QProgressDialog>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QInputDialog>
+#include <QTimer>
+#include <QStatusBar>
+#include <QApplication>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "connectdialog.h"
 #include "sessionmanager.h"
 #include "outputmanager.h"
-#include "searchhighlighter.h"
 
-/// maximum count of document blocks for the bootom output
-const int MAX_OUTPUT_LINES = 100;
+/// default maximum refresh rate of the output views, in Hz
+const int DEFAULT_MAX_REFRESH_RATE = 30;
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     search_widget(0),
     search_input(0),
-    progress_dialog(0)
+    progress_dialog(0),
+    max_refresh_rate(DEFAULT_MAX_REFRESH_RATE),
+    triggers_loaded(false)
 {
     ui->setupUi(this);
 
+    // output views are refreshed at most max_refresh_rate times per second
+    render_timer = new QTimer(this);
+    render_timer->setSingleShot(true);
+    connect(render_timer, &QTimer::timeout, this, &MainWindow::refreshOutputs);
+    last_render.start();
+
     // create session and output managers
     output_mgr = new OutputManager(this);
     session_mgr = new SessionManager(this);
     connect_dlg = new ConnectDialog(this);
 
+    // both outputs display the lines kept by the output manager, bottom
+    // output highlights search results without moving to them
+    ui->mainOutput->setOutputManager(output_mgr);
+    ui->bottomOutput->setOutputManager(output_mgr);
+    ui->bottomOutput->setSearchCursor(false);
+
     // show connection dialog
     connect(ui->connectButton, &QAbstractButton::clicked, connect_dlg, &ConnectDialog::show);
 
     // handle reception of new data from serial port
     connect(session_mgr, &SessionManager::dataReceived, this, &MainWindow::handleDataReceived);
 
-    // get data formatted for display and show it in output view
-    connect(output_mgr, &OutputManager::dataConverted, this, &MainWindow::addDataToView);
+    // refresh output views once new data has been stored
+    connect(output_mgr, &OutputManager::dataAdded, this, &MainWindow::scheduleRefresh);
 
     // get data formatted for display and show it in output view
     connect(ui->inputBox, &HistoryComboBox::lineEntered, this, &MainWindow::handleNewInput);
@@ -62,14 +76,25 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(session_mgr, &SessionManager::sessionClosed, this, &MainWindow::handleSessionClosed);
 
     // clear both output text when 'clear' is clicked
-    connect(ui->clearButton, &QPushButton::clicked, ui->mainOutput, &QPlainTextEdit::clear);
-    connect(ui->clearButton, &QPushButton::clicked, ui->bottomOutput, &QPlainTextEdit::clear);
+    connect(ui->clearButton, &QPushButton::clicked, ui->mainOutput, &OutputView::clear);
+    connect(ui->clearButton, &QPushButton::clicked, ui->bottomOutput, &OutputView::clear);
 
     // connect open/close session slots
+    connect(connect_dlg, &ConnectDialog::openDeviceClicked, this, &MainWindow::handleOpenDevice);
     connect(connect_dlg, &ConnectDialog::openDeviceClicked, session_mgr, &SessionManager::openSession);
     connect(ui->disconnectButton, &QPushButton::clicked, session_mgr, &SessionManager::closeSession);
 
+    // replay a dump file through the reception pipeline
+    connect(ui->replayButton, &QPushButton::clicked, this, &MainWindow::handleReplay);
+    connect(session_mgr, &SessionManager::replayStarted, this, &MainWindow::handleReplayStarted);
+    connect(session_mgr, &SessionManager::replayEnded, this, &MainWindow::handleReplayEnded);
+
+    // react to patterns in received data
+    connect(ui->triggersButton, &QPushButton::clicked, this, &MainWindow::handleTriggers);
+    connect(session_mgr, &SessionManager::triggerFired, this, &MainWindow::handleTriggerFired);
+
     connect(ui->splitOutputBtn, &QPushButton::clicked, this, &MainWindow::toggleOutputSplitter);
+    connect(ui->hexViewBtn, &QToolButton::toggled, this, &MainWindow::toggleHexView);
 
     // load search widget and hide it
     QUiLoader loader;
@@ -83,28 +108,20 @@ MainWindow::MainWindow(QWidget *parent) :
     }
     search_widget->hide();
 
-    // create the search results highlighter for main output
-    SearchHighlighter *search_highlighter_main = new SearchHighlighter(ui->mainOutput->document());
-    connect(search_input, &QLineEdit::textChanged, search_highlighter_main, &SearchHighlighter::setSearchString);
-
-    // search result highlighter (without search cursor) for bottom output
-    SearchHighlighter *search_highlighter_bottom = new SearchHighlighter(ui->bottomOutput->document(), false);
-    connect(search_input, &QLineEdit::textChanged, search_highlighter_bottom, &SearchHighlighter::setSearchString);
+    // received data is searched in background, both outputs highlight the results
+    connect(search_input, &QLineEdit::textChanged, output_mgr, &OutputManager::setSearchString);
 
     // connect search-related signals/slots
     connect(search_prev_button, &QPushButton::clicked,
-	search_highlighter_main, &SearchHighlighter::previousOccurence);
+	ui->mainOutput, &OutputView::previousOccurence);
     connect(search_next_button, &QPushButton::clicked,
-	search_highlighter_main, &SearchHighlighter::nextOccurence);
-    connect(search_highlighter_main, &SearchHighlighter::cursorPosChanged,
-	this, &MainWindow::handleCursosPosChanged);
-    connect(search_highlighter_main, &SearchHighlighter::totalOccurencesChanged,
+	ui->mainOutput, &OutputView::nextOccurence);
+    connect(ui->mainOutput, &OutputView::totalOccurencesChanged,
 	this, &MainWindow::handleTotalOccurencesChanged);
     connect(ui->searchButton, &QPushButton::toggled, this, &MainWindow::showSearchWidget);
 
     // additional configuration for bottom output
     ui->bottomOutput->hide();
-    ui->bottomOutput->document()->setMaximumBlockCount(MAX_OUTPUT_LINES);
 
     // populate file transfer protocol combobox
     ui->protocolCombo->addItem("XModem", SessionManager::XMODEM);
@@ -113,7 +130,9 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // transfer file over XModem protocol
     connect(ui->fileTransferButton, &QPushButton::clicked, this, &MainWindow::handleFileTransfer);
+    connect(ui->receiveFileButton, &QPushButton::clicked, this, &MainWindow::handleFileReceive);
     connect(session_mgr, &SessionManager::fileTransferEnded, this, &MainWindow::handleFileTransferEnded);
+    connect(session_mgr, &SessionManager::fileTransferMeasured, this, &MainWindow::handleFileTransferMeasured);
 
     // fill end of line chars combobox
     ui->eolCombo->addItem(QStringLiteral("CR"), CR);
@@ -138,6 +157,11 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::handleOpenDevice(const QHash<QString, QString> &config)
+{
+    output_mgr->setEncoding(static_cast<TextDecoder::Encoding>(config["encoding"].toInt()));
+}
+
 void MainWindow::handleSessionOpened()
 {
     // clear output buffer
@@ -149,9 +173,12 @@ void MainWindow::handleSessionOpened()
 
     ui->connectButton->setDisabled(true);
     ui->disconnectButton->setEnabled(true);
+    ui->replayButton->setDisabled(true);
 
     // enable file transfer and input line
     ui->fileTransferButton->setEnabled(true);
+    ui->receiveFileButton->setEnabled(true);
+    ui->protocolCombo->setEnabled(true);
     ui->inputBox->setEnabled(true);
 }
 
@@ -159,47 +186,198 @@ void MainWindow::handleSessionClosed()
 {
     ui->connectButton->setEnabled(true);
     ui->disconnectButton->setDisabled(true);
+    ui->replayButton->setEnabled(true);
 
     // disable file transfer and input line
     ui->fileTransferButton->setDisabled(true);
+    ui->receiveFileButton->setDisabled(true);
+    ui->protocolCombo->setDisabled(true);
     ui->inputBox->setDisabled(true);
 }
 
-void MainWindow::handleFileTransfer()
+void MainWindow::handleReplay()
 {
+    if (session_mgr->isReplaying())
+    {
+        session_mgr->stopReplay();
+        return;
+    }
+
     QString filename = QFileDialog::getOpenFileName(
-                this, QStringLiteral("Select file to send transfer"));
+                this, QStringLiteral("Select dump file to replay"));
+
+    if (filename.isNull())
+        return;
+
+    // speed factors, 0 meaning as fast as possible
+    QStringList speeds;
+    speeds << QStringLiteral("original timing") << QStringLiteral("2x")
+           << QStringLiteral("10x") << QStringLiteral("100x")
+           << QStringLiteral("as fast as possible");
+    static const double speed_factors[] = { 1, 2, 10, 100, 0 };
+
+    bool ok;
+    QString speed = QInputDialog::getItem(this, QStringLiteral("Replay"),
+        QStringLiteral("Replay speed (capture dumps only)"), speeds, 0, false, &ok);
+
+    if (!ok)
+        return;
+
+    session_mgr->startReplay(filename, speed_factors[speeds.indexOf(speed)]);
+}
+
+void MainWindow::handleReplayStarted()
+{
+    // clear output buffer and both output windows, as for a new session
+    output_mgr->clear();
+    ui->mainOutput->clear();
+    ui->bottomOutput->clear();
+
+    ui->connectButton->setDisabled(true);
+    ui->replayButton->setText(QStringLiteral("Stop replay"));
+}
+
+void MainWindow::handleReplayEnded(bool ok, qint64 bytes, qint64 msecs)
+{
+    ui->connectButton->setEnabled(true);
+    ui->replayButton->setText(QStringLiteral("Replay"));
+
+    if (!ok)
+    {
+        QMessageBox::warning(this, tr("Error"), QStringLiteral("Can't read dump file"));
+        return;
+    }
+
+    // throughput of the whole reception and display pipeline
+    const double seconds = qMax<qint64>(msecs, 1) / 1000.0;
+    QMessageBox::information(this, tr("Cutecom-ng"),
+        QStringLiteral("Replayed %1 bytes in %2 s (%3 MB/s)")
+            .arg(bytes).arg(seconds, 0, 'f', 2).arg(bytes / seconds / 1e6, 0, 'f', 2));
+}
+
+void MainWindow::handleTriggers()
+{
+    if (triggers_loaded)
+    {
+        session_mgr->setTriggers(QVector<TriggerEngine::Trigger>());
+        triggers_loaded = false;
+        ui->triggersButton->setText(QStringLiteral("Triggers"));
+        return;
+    }
+
+    QString filename = QFileDialog::getOpenFileName(
+                this, QStringLiteral("Select trigger file"));
+
+    if (filename.isNull())
+        return;
+
+    QVector<TriggerEngine::Trigger> triggers;
+    QString error;
+    if (!TriggerEngine::load(filename, &triggers, &error))
+    {
+        QMessageBox::warning(this, tr("Error"),
+            QStringLiteral("Can't load trigger file: %1").arg(error));
+        return;
+    }
+
+    session_mgr->setTriggers(triggers);
+    triggers_loaded = true;
+    ui->triggersButton->setText(QStringLiteral("Clear triggers"));
+    statusBar()->showMessage(QStringLiteral("%1 triggers loaded").arg(triggers.size()));
+}
+
+void MainWindow::handleTriggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs)
+{
+    static const char *const action_names[] = { "sent", "marked", "dump started", "dump stopped" };
+
+    const SessionManager::TriggerStatistics stats = session_mgr->triggerStatistics();
+    statusBar()->showMessage(
+        QStringLiteral("'%1' %2 after %3 us (fired %4 times, max %5 us)")
+            .arg(QString::fromUtf8(trigger.pattern)).arg(action_names[trigger.action])
+            .arg(latency_usecs).arg(stats.fired).arg(stats.max_latency_usecs));
+
+    if (trigger.action == TriggerEngine::Mark)
+        QApplication::alert(this);
+}
+
+void MainWindow::handleFileTransfer()
+{
+    QStringList filenames;
+    if (ui->protocolCombo->currentData().toInt() != SessionManager::XMODEM)
+    {
+        // batch protocol, all files are sent in one session
+        filenames = QFileDialog::getOpenFileNames(
+                    this, QStringLiteral("Select files to send"));
+    }
+    else
+    {
+        const QString filename = QFileDialog::getOpenFileName(
+                    this, QStringLiteral("Select file to send transfer"));
+        if (!filename.isNull())
+            filenames.append(filename);
+    }
+
+    if (filenames.isEmpty())
+        return;
+
+    startFileTransfer(filenames, FileTransfer::Send);
+}
+
+void MainWindow::handleFileReceive()
+{
+    if (ui->protocolCombo->currentData().toInt() != SessionManager::XMODEM)
+    {
+        QMessageBox::warning(this, tr("Cutecom-ng"),
+            QStringLiteral("Files can only be received over XModem"));
+        return;
+    }
+
+    QString filename = QFileDialog::getSaveFileName(
+                this, QStringLiteral("Select file to write received data to"));
 
     if (filename.isNull())
         return;
 
-    Q_ASSERT_X(progress_dialog == 0, "MainWindow::handleFileTransfer()", "progress_dialog should be null");
+    startFileTransfer(QStringList(filename), FileTransfer::Receive);
+}
+
+void MainWindow::startFileTransfer(const QStringList &filenames, FileTransfer::Direction direction)
+{
+    Q_ASSERT_X(progress_dialog == 0, "MainWindow::startFileTransfer()", "progress_dialog should be null");
 
     // display a progress dialog
     progress_dialog = new QProgressDialog(this);
     connect(progress_dialog, &QProgressDialog::canceled,
             session_mgr, &SessionManager::handleTransferCancelledByUser);
 
-    progress_dialog->setRange(0, 100);
+    // received file size is unknown, show a busy indicator
+    progress_dialog->setRange(0, direction == FileTransfer::Receive ? 0 : 100);
     progress_dialog->setWindowModality(Qt::ApplicationModal);
-    progress_dialog->setLabelText(
+    progress_dialog->setLabelText(direction == FileTransfer::Receive ?
+                QStringLiteral("Waiting for sender") :
                 QStringLiteral("Initiating connection with receiver"));
 
     // update progress dialog
     connect(session_mgr, &SessionManager::fileTransferProgressed,
             this, &MainWindow::handleFileTransferProgressed);
 
-    int protocol = ui->protocolCombo->currentData().toInt();
-    session_mgr->transferFile(filename,
-        static_cast<SessionManager::Protocol>(protocol));
-
     // disable UI elements acting on QSerialPort instance, as long as
     // objectds involved in FileTransferred are not destroyed or back
-    // to their pre-file-transfer state
+    // to their pre-file-transfer state. Done first, a transfer that can't
+    // start ends right away
     ui->fileTransferButton->setEnabled(false);
+    ui->receiveFileButton->setEnabled(false);
+    ui->protocolCombo->setEnabled(false);
     ui->disconnectButton->setEnabled(false);
     ui->inputBox->setEnabled(false);
 
+    const SessionManager::Protocol protocol =
+        static_cast<SessionManager::Protocol>(ui->protocolCombo->currentData().toInt());
+    if (direction == FileTransfer::Send)
+        session_mgr->transferFiles(filenames, protocol);
+    else
+        session_mgr->transferFile(filenames.first(), protocol, direction);
+
     // progress dialog event loop
     progress_dialog->exec();
 
@@ -209,11 +387,39 @@ void MainWindow::handleFileTransfer()
 
 void MainWindow::handleFileTransferProgressed(int percent)
 {
+    // the label is updated with the counters
     if (progress_dialog)
-    {
         progress_dialog->setValue(percent);
-        progress_dialog->setLabelText(QStringLiteral("Transferring file"));
+}
+
+void MainWindow::handleFileTransferMeasured(const FileTransfer::Statistics &stats)
+{
+    if (!progress_dialog)
+        return;
+
+    const qint64 throughput = stats.block_bytes * 1000 / qMax<qint64>(stats.elapsed_msecs, 1);
+    QString label = QStringLiteral("Transferring file\n%1 bytes at %2 bytes/s")
+        .arg(stats.block_bytes).arg(throughput);
+
+    // a pseudo-terminal has no meaningful line rate
+    if (stats.line_bytes_per_sec > 0)
+    {
+        label += QStringLiteral(", %1% of the line (%2 bytes/s)")
+            .arg(100 * throughput / stats.line_bytes_per_sec).arg(stats.line_bytes_per_sec);
     }
+
+    if (stats.rtt_count > 0)
+    {
+        label += QStringLiteral("\nround-trip %1 ms, average %2 ms, max %3 ms")
+            .arg(stats.rtt_last_usecs / 1000.0, 0, 'f', 1)
+            .arg(stats.rtt_total_usecs / 1000.0 / stats.rtt_count, 0, 'f', 1)
+            .arg(stats.rtt_max_usecs / 1000.0, 0, 'f', 1);
+    }
+
+    label += QStringLiteral("\n%1 blocks, %2 retries, %3 NAKs, %4 CANs, %5 timeouts")
+        .arg(stats.blocks).arg(stats.retries).arg(stats.naks).arg(stats.cancels).arg(stats.timeouts);
+
+    progress_dialog->setLabelText(label);
 }
 
 void MainWindow::handleFileTransferEnded(FileTransfer::TransferError error)
@@ -223,8 +429,20 @@ void MainWindow::handleFileTransferEnded(FileTransfer::TransferError error)
         case FileTransfer::LocalCancelledError:
             break;
         case FileTransfer::NoError:
-            QMessageBox::information(this, tr("Cutecom-ng"), QStringLiteral("File transferred successfully"));
+        {
+            const FileTransfer::Statistics stats = session_mgr->fileTransferStatistics();
+            QMessageBox::information(this, tr("Cutecom-ng"),
+                QStringLiteral("File transferred successfully\n"
+                               "%1 bytes in %2 s (%3 bytes/s)\n"
+                               "%4 retries, %5 duplicate packets, %6 NAKs, %7 timeouts\n"
+                               "round-trip %8 ms average, %9 ms max")
+                    .arg(stats.bytes).arg(stats.elapsed_msecs / 1000.0, 0, 'f', 1)
+                    .arg(stats.bytes * 1000 / qMax<qint64>(stats.elapsed_msecs, 1))
+                    .arg(stats.retries).arg(stats.duplicates).arg(stats.naks).arg(stats.timeouts)
+                    .arg(stats.rtt_total_usecs / 1000.0 / qMax(stats.rtt_count, 1), 0, 'f', 1)
+                    .arg(stats.rtt_max_usecs / 1000.0, 0, 'f', 1));
             break;
+        }
         default:
             progress_dialog->setLabelText(FileTransfer::errorString(error));
             break;
@@ -232,6 +450,8 @@ void MainWindow::handleFileTransferEnded(FileTransfer::TransferError error)
 
     // re-enable UI elements acting on QSerialPort instance
     ui->fileTransferButton->setEnabled(true);
+    ui->receiveFileButton->setEnabled(true);
+    ui->protocolCombo->setEnabled(true);
     ui->disconnectButton->setEnabled(true);
     ui->inputBox->setEnabled(true);
 }
@@ -248,57 +468,52 @@ void MainWindow::handleNewInput(QString entry)
     }
 }
 
-void MainWindow::addDataToView(const QString & textdata)
+void MainWindow::scheduleRefresh()
 {
-    // problem : QTextEdit interprets a '\r' as a new line, so if a buffer ending
-    //           with '\r\n' happens to be cut in the middle, there will be 1 extra
-    //           line jump in the QTextEdit. To prevent we remove ending '\r' and
-    //           prepend them to the next received buffer
+    // views are updated at most once per frame
+    if (!render_timer->isActive())
+        render_timer->start(qMax<int>(0, 1000 / max_refresh_rate - last_render.elapsed()));
+}
 
-    // flag indicating that the previously received buffer ended with CR
-    static bool prev_ends_with_CR = false;
+void MainWindow::refreshOutputs()
+{
+    last_render.restart();
 
-    QString newdata;
-    if (prev_ends_with_CR)
-    {
-        // CR was removed at the previous buffer, so now we prepend it
-        newdata.append('\r');
-        prev_ends_with_CR = false;
-    }
+    // views read new lines from the output manager, main output scrolls
+    // down unless in split mode, bottom output always does
+    ui->mainOutput->refresh();
+    if (ui->bottomOutput->isVisible())
+        ui->bottomOutput->refresh();
+}
 
-    if (textdata.length() > 0)
-    {
-        QString::const_iterator end_cit = textdata.cend();
-        if (textdata.endsWith('\r'))
-        {
-            // if buffer ends with CR, we don't copy it
-            end_cit--;
-            prev_ends_with_CR = true;
-        }
-        std::copy(textdata.begin(), end_cit, std::back_inserter(newdata));
-    }
+void MainWindow::setMaxRefreshRate(int hz)
+{
+    max_refresh_rate = qBound(1, hz, 1000);
+}
 
-    // record end cursor position before adding text
-    QTextCursor prev_end_cursor(ui->mainOutput->document());
-    prev_end_cursor.movePosition(QTextCursor::End);
+void MainWindow::setScrollbackMemoryLimit(qint64 bytes)
+{
+    output_mgr->setMemoryLimit(bytes);
+}
 
-    if (ui->bottomOutput->isVisible())
-    {
-        // append text to the top output and stay at current position
-        QTextCursor cursor(ui->mainOutput->document());
-        cursor.movePosition(QTextCursor::End);
-        cursor.insertText(newdata);
-    }
-    else
-    {
-        // append text to the top output and scroll down
-        ui->mainOutput->moveCursor(QTextCursor::End);
-        ui->mainOutput->insertPlainText(newdata);
-    }
+void MainWindow::setScrollbackLines(qint64 lines)
+{
+    output_mgr->setScrollbackLines(lines);
+}
+
+void MainWindow::setTransferFollow(int idle_msecs)
+{
+    session_mgr->setTransferFollow(idle_msecs);
+}
 
-    // append text to bottom output and scroll
-    ui->bottomOutput->moveCursor(QTextCursor::End);
-    ui->bottomOutput->insertPlainText(newdata);
+void MainWindow::setTransferWindow(int bytes)
+{
+    session_mgr->setTransferWindow(bytes);
+}
+
+void MainWindow::setTransferStatsDir(const QString &dir)
+{
+    session_mgr->setTransferStatsDir(dir);
 }
 
 void MainWindow::handleDataReceived(const QByteArray &data)
@@ -309,6 +524,17 @@ void MainWindow::handleDataReceived(const QByteArray &data)
 void MainWindow::toggleOutputSplitter()
 {
     ui->bottomOutput->setVisible(!ui->bottomOutput->isVisible());
+    ui->bottomOutput->refresh();
+
+    // browsing mode: main output stays at current position
+    ui->mainOutput->setAutoScroll(!ui->bottomOutput->isVisible());
+}
+
+void MainWindow::toggleHexView(bool hex)
+{
+    const OutputView::DisplayMode mode = hex ? OutputView::HexMode : OutputView::TextMode;
+    ui->mainOutput->setDisplayMode(mode);
+    ui->bottomOutput->setDisplayMode(mode);
 }
 
 bool MainWindow::eventFilter(QObject *target, QEvent *event)
@@ -387,17 +613,6 @@ void MainWindow::showSearchWidget(bool show)
     animation->start(QAbstractAnimation::DeleteWhenStopped);
 }
 
-void MainWindow::handleCursosPosChanged(int pos)
-{
-    // move cursor
-    QTextCursor text_cursor = ui->mainOutput->textCursor();
-    text_cursor.setPosition(pos);
-
-    // ensure search result cursor is visible
-    ui->mainOutput->ensureCursorVisible();
-    ui->mainOutput->setTextCursor(text_cursor);
-}
-
 void MainWindow::handleTotalOccurencesChanged(int total_occurences)
 {
     if (total_occurences == 0)
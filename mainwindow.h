@@ -13,8 +13,11 @@
 #define MAINWINDOW_H
 
 #include "filetransfer.h"
+#include "triggerengine.h"
 
 #include <QMainWindow>
+#include <QElapsedTimer>
+#include <QHash>
 
 namespace Ui {
 class MainWindow;
@@ -26,6 +29,7 @@ class ConnectDialog;
 class QLineEdit;
 class QToolButton;
 class QProgressDialog;
+class QTimer;
 
 /**
  * \brief main cutecom-ng window
@@ -60,12 +64,68 @@ private:
     QProgressDialog     *progress_dialog;
     QByteArray          _end_of_line;
 
+    /// fires when output views should be refreshed
+    QTimer              *render_timer;
+
+    /// time since last refresh of output views
+    QElapsedTimer       last_render;
+
+    /// maximum number of output views updates per second
+    int                 max_refresh_rate;
+
+    /// indicate that triggers are applied to received data
+    bool                triggers_loaded;
+
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    /**
+     * \brief set the maximum refresh rate of the output views
+     * \param hz maximum number of updates per second
+     */
+    void setMaxRefreshRate(int hz);
+
+    /**
+     * \brief set the maximum amount of memory used to keep received data,
+     *  older data is moved to a temporary file
+     * \param bytes memory limit
+     */
+    void setScrollbackMemoryLimit(qint64 bytes);
+
+    /**
+     * \brief set the number of most recent lines kept in memory, older lines
+     *  are archived in a temporary file, and can still be browsed and searched
+     * \param lines number of lines
+     */
+    void setScrollbackLines(qint64 lines);
+
+    /**
+     * \brief send growing files until they have not grown for a while
+     * \param idle_msecs time without growth ending a file, 0 to disable
+     */
+    void setTransferFollow(int idle_msecs);
+
+    /**
+     * \brief limit the data ZModem sends ahead of the receiver acknowledgements
+     * \param bytes window size, 0 to stream whole files
+     */
+    void setTransferWindow(int bytes);
+
+    /**
+     * \brief write the statistics of each file transfer to a file of dir
+     * \param dir existing directory, empty to disable
+     */
+    void setTransferStatsDir(const QString &dir);
+
 private:
 
+    /**
+     * \brief handle openDeviceClicked signal, apply display settings of the session
+     * \param config session configuration, see ConnectDialog::openDeviceClicked
+     */
+    void handleOpenDevice(const QHash<QString, QString> &config);
+
     /**
      * \brief handle sessionOpened signal
      */
@@ -76,21 +136,72 @@ private:
      */
     void handleSessionClosed();
 
+    /**
+     * \brief handle replay button clicks: start or stop a replay
+     */
+    void handleReplay();
+
+    /**
+     * \brief handle replayStarted signal
+     */
+    void handleReplayStarted();
+
+    /**
+     * \brief handle replayEnded signal
+     * \param ok     false if dump file could not be read
+     * \param bytes  amount of bytes replayed
+     * \param msecs  replay duration
+     */
+    void handleReplayEnded(bool ok, qint64 bytes, qint64 msecs);
+
+    /**
+     * \brief handle triggers button clicks: load a trigger file or clear triggers
+     */
+    void handleTriggers();
+
+    /**
+     * \brief handle triggerFired signal: show fired trigger, alert the user on marks
+     * \param trigger        fired trigger
+     * \param latency_usecs  time from data reception to action completion
+     */
+    void handleTriggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs);
+
     /**
      * \brief handle buttonClicked on the x/y/zmodem buttons
      * \param type
      */
     void handleFileTransfer();
 
+    /**
+     * \brief handle clicked signal of receiveFileButton
+     */
+    void handleFileReceive();
+
+    /**
+     * \brief start a file transfer with the selected protocol, and run a
+     *  progress dialog until it ends
+     * \param filenames files to send, or file to write received data to
+     * \param direction send or receive filenames
+     */
+    void startFileTransfer(const QStringList &filenames, FileTransfer::Direction direction);
+
     /**
      * \brief handle new input
      */
     void handleNewInput(QString entry);
 
     /**
-     * \brief add data to the output view
+     * \brief schedule a refresh of the output views, they read new data
+     *  from the output manager
+     *
+     * views are refreshed at most max_refresh_rate times per second
      */
-    void addDataToView(const QString & textdata);
+    void scheduleRefresh();
+
+    /**
+     * \brief refresh output views
+     */
+    void refreshOutputs();
 
     /**
      * \brief handle arrival of new data
@@ -102,6 +213,12 @@ private:
      */
     void toggleOutputSplitter();
 
+    /**
+     * \brief switch main output between text and hex dump
+     * \param hex show hex dump?
+     */
+    void toggleHexView(bool hex);
+
     /**
      * \brief event filter
      */
@@ -113,12 +230,6 @@ private:
      */
     void showSearchWidget(bool show);
 
-    /**
-     * \brief handle search result cursor position changes
-     * \param pos pos of search result cursor
-     */
-    void handleCursosPosChanged(int pos);
-
     /**
      * \brief handle changes of number of search string occurences
      * \param total_occurences
@@ -137,6 +248,12 @@ private:
      */
     void handleFileTransferProgressed(int percent);
 
+    /**
+     * \brief handle fileTransferMeasured signal, show live counters
+     * \param stats transfer counters so far
+     */
+    void handleFileTransferMeasured(const FileTransfer::Statistics &stats);
+
     /**
      * \brief handle currentIndexChanged for end of line char combobox
      * \param index index of selected item
@@ -10,28 +10,125 @@
  */
 
 #include "outputmanager.h"
+#include "searchengine.h"
 
-OutputManager::OutputManager(QObject *parent) : QObject(parent)
-{
+/// default number of lines kept in memory
+static const qint64 DEFAULT_SCROLLBACK_LINES = 100000;
 
+OutputManager::OutputManager(QObject *parent) :
+    QObject(parent),
+    scrollback_lines(DEFAULT_SCROLLBACK_LINES),
+    _encoding(TextDecoder::Utf8)
+{
+    _lines.setResidentLines(scrollback_lines);
+    search_engine = new SearchEngine(&_buffer, this);
 }
 
 void OutputManager::operator << (const QByteArray &data)
 {
     // append raw data to the buffer, untouched
     _buffer.append(data);
+    _lines.append(data.constData(), data.size());
+    archiveLines();
+
+    // keep search results up to date
+    search_engine->dataAppended();
 
-    // notify that we have new data
-    emit dataConverted(QString(data));
+    // notify that we have new data, views read it from the buffer
+    emit dataAdded(data);
 }
 
-const QByteArray& OutputManager::buffer()
+const ByteStore& OutputManager::buffer() const
 {
     return _buffer;
 }
 
+const LineIndex& OutputManager::lines() const
+{
+    return _lines;
+}
+
+QByteArray OutputManager::lineData(qint64 line, int max_len, qint64 from) const
+{
+    const qint64 start = qMax(_lines.lineStart(line), from);
+    QByteArray data = _buffer.read(start, qBound<qint64>(0, _lines.lineEnd(line) - start, max_len));
+
+    // strip end of line chars
+    if (data.endsWith('\n'))
+        data.chop(1);
+    if (data.endsWith('\r'))
+        data.chop(1);
+
+    return data;
+}
+
+QString OutputManager::lineText(qint64 line, int max_len, qint64 from) const
+{
+    return decodeLine(lineData(line, max_len, from));
+}
+
+QString OutputManager::decodeLine(const QByteArray &data) const
+{
+    // a UTF-8 sequence has at most 3 continuation bytes
+    int start = 0;
+    if (_encoding == TextDecoder::Utf8)
+    {
+        while (start < qMin(3, data.size()) && (data.at(start) & 0xC0) == 0x80)
+            ++start;
+    }
+
+    // the decoder keeps an incomplete trailing sequence, it is never output
+    TextDecoder line_decoder(_encoding);
+    return line_decoder.decode(data.constData() + start, data.size() - start);
+}
+
+const SearchEngine* OutputManager::searchEngine() const
+{
+    return search_engine;
+}
+
+void OutputManager::setSearchString(const QString &search)
+{
+    search_string = search;
+    search_engine->setPattern(TextDecoder(_encoding).encode(search));
+}
+
+void OutputManager::setMemoryLimit(qint64 bytes)
+{
+    _buffer.setMemoryLimit(bytes);
+}
+
+void OutputManager::setScrollbackLines(qint64 lines)
+{
+    scrollback_lines = qMax<qint64>(1, lines);
+    _lines.setResidentLines(scrollback_lines);
+    archiveLines();
+}
+
+void OutputManager::setEncoding(TextDecoder::Encoding encoding)
+{
+    _encoding = encoding;
+
+    // search string bytes depend on the encoding
+    if (!search_string.isEmpty())
+        search_engine->setPattern(TextDecoder(_encoding).encode(search_string));
+}
+
+TextDecoder::Encoding OutputManager::encoding() const
+{
+    return _encoding;
+}
+
 
 void OutputManager::clear()
 {
     _buffer.clear();
+    _lines.clear();
+    search_engine->clear();
+}
+
+void OutputManager::archiveLines()
+{
+    const qint64 first_resident = qMax<qint64>(0, _lines.lineCount() - scrollback_lines);
+    _buffer.archiveBefore(_lines.lineStart(first_resident));
 }
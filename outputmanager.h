@@ -12,13 +12,22 @@
 #ifndef OUTPUTMANAGER_H
 #define OUTPUTMANAGER_H
 
+#include "bytestore.h"
+#include "textdecoder.h"
+#include "lineindex.h"
+
 #include <QObject>
 #include <QByteArray>
 
+class SearchEngine;
 class QTextEdit;
 
 /**
  * \brief handle output data
+ *
+ * only the last scrollback lines, and their data, are kept in memory: older
+ * lines are archived in temporary files, where they can still be displayed
+ * and searched.
  */
 class OutputManager : public QObject
 {
@@ -27,15 +36,94 @@ class OutputManager : public QObject
 private:
 
     /// data received in current session (concatenated)
-    QByteArray _buffer;
+    ByteStore _buffer;
+
+    /// lines of internal buffer
+    LineIndex _lines;
+
+    /// number of most recent lines kept in memory, older ones are archived
+    qint64 scrollback_lines;
+
+    /// encoding of received data, views decode the lines they display
+    TextDecoder::Encoding _encoding;
+
+    /// search string
+    QString search_string;
+
+    /// search engine of internal buffer
+    SearchEngine *search_engine;
 
 public:
     explicit OutputManager(QObject *parent = 0);
 
     /**
      * \brief retrieve internal buffer
+     * \note oldest data may have been spilled to disk, see ByteStore
+     */
+    const ByteStore& buffer() const;
+
+    /**
+     * \brief retrieve line index of internal buffer
+     */
+    const LineIndex& lines() const;
+
+    /**
+     * \brief return the raw data of a line, without end of line chars
+     * \param line     line number
+     * \param max_len  maximum amount of bytes returned
+     * \param from     offset before which bytes are ignored
+     */
+    QByteArray lineData(qint64 line, int max_len, qint64 from = 0) const;
+
+    /**
+     * \brief return the text of a line, without end of line chars
+     * \param line     line number
+     * \param max_len  maximum amount of bytes decoded
+     * \param from     offset before which bytes are ignored
+     */
+    QString lineText(qint64 line, int max_len, qint64 from = 0) const;
+
+    /**
+     * \brief decode data returned by lineData()
+     *
+     * lineData() starts inside a multi-byte sequence when from falls in the
+     * middle of one, and ends inside one when the line is cut at max_len:
+     * leading continuation bytes are skipped and an incomplete trailing
+     * sequence is dropped, so that each line decodes on its own
+     */
+    QString decodeLine(const QByteArray &data) const;
+
+    /**
+     * \brief retrieve search engine of internal buffer
      */
-    const QByteArray& buffer();
+    const SearchEngine* searchEngine() const;
+
+    /**
+     * \brief search a string in internal buffer
+     * \param search string to find, encoded with current encoding, empty to stop searching
+     */
+    void setSearchString(const QString &search);
+
+    /**
+     * \brief set the maximum amount of memory used by the internal buffer
+     */
+    void setMemoryLimit(qint64 bytes);
+
+    /**
+     * \brief set the number of most recent lines kept in memory, older
+     *  lines and their data are moved to disk
+     */
+    void setScrollbackLines(qint64 lines);
+
+    /**
+     * \brief set the encoding of received data
+     */
+    void setEncoding(TextDecoder::Encoding encoding);
+
+    /**
+     * \brief return the encoding of received data
+     */
+    TextDecoder::Encoding encoding() const;
 
     /**
      * \brief clear internal buffer
@@ -44,14 +132,25 @@ public:
 
     /**
      * \brief handle new data
-     * append new data to the internal buffer
-     * and emit dataConverted signal
+     * append new data to the internal buffer, index and search it,
+     * and emit dataAdded signal
      */
     void operator << (const QByteArray &data);
 
 signals:
 
-    void dataConverted(const QString & data);
+    /**
+     * \brief signal emitted when data has been appended to the internal buffer
+     * \param data    byte array data, as received
+     */
+    void dataAdded(const QByteArray &data);
+
+private:
+
+    /**
+     * \brief move data preceding the scrollback lines to disk
+     */
+    void archiveLines();
 };
 
 #endif // OUTPUTMANAGER_H
@@ -0,0 +1,609 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief OutputView class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "outputview.h"
+#include "outputmanager.h"
+#include "searchengine.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <climits>
+
+/// maximum amount of bytes displayed per line
+const int MAX_LINE_LENGTH = 4096;
+
+/// distance between tab stops, in chars
+const int TAB_WIDTH = 8;
+
+/// left and right margins, in pixels
+const int MARGIN = 4;
+
+/// search results background color
+const Qt::GlobalColor SEARCHRESULT_BACKCOL = Qt::yellow;
+
+/// current search result background color
+const Qt::GlobalColor CURSOR_SEARCHRESULT_BACKCOL = Qt::red;
+
+/// bytes per hex dump row
+const int HEX_ROW_BYTES = 16;
+
+/// hex dump row layout: "0000000000  00 .. 00  00 .. 00  |................|"
+const int HEX_OFFSET_DIGITS = 10;
+const int HEX_BYTES_COLUMN = HEX_OFFSET_DIGITS + 2;
+const int HEX_ASCII_COLUMN = HEX_BYTES_COLUMN + HEX_ROW_BYTES * 3 + 2;
+const int HEX_ROW_LENGTH = HEX_ASCII_COLUMN + HEX_ROW_BYTES + 1;
+
+/**
+ * \brief hex dump representation of every byte value
+ */
+struct HexTable
+{
+    /// two hex digits
+    QChar hex[256][2];
+
+    /// printable char, or '.'
+    QChar ascii[256];
+
+    HexTable()
+    {
+        static const char digits[] = "0123456789abcdef";
+        for (int b = 0; b < 256; ++b)
+        {
+            hex[b][0] = QLatin1Char(digits[b >> 4]);
+            hex[b][1] = QLatin1Char(digits[b & 0xF]);
+            ascii[b] = QLatin1Char(b >= 0x20 && b < 0x7F ? char(b) : '.');
+        }
+    }
+};
+
+static const HexTable &hexTable()
+{
+    static const HexTable table;
+    return table;
+}
+
+/**
+ * \brief return the column of a byte in a hex dump row
+ * \param index  index of the byte in the row
+ */
+static inline int hexColumn(int index)
+{
+    // extra space between the two halves of the row
+    return HEX_BYTES_COLUMN + index * 3 + (index >= HEX_ROW_BYTES / 2 ? 1 : 0);
+}
+
+OutputView::OutputView(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    output_mgr(0),
+    display_mode(TextMode),
+    start_offset(0),
+    auto_scroll(true),
+    max_line_width(0),
+    occurence_offset(-1),
+    search_cursor(true)
+{
+    selection_anchor.line = -1;
+    selection_anchor.column = 0;
+    selection_cursor = selection_anchor;
+
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    viewport()->setCursor(Qt::IBeamCursor);
+}
+
+void OutputView::setOutputManager(const OutputManager *mgr)
+{
+    output_mgr = mgr;
+    if (output_mgr)
+    {
+        connect(output_mgr->searchEngine(), &SearchEngine::matchesChanged,
+                this, &OutputView::handleMatchesChanged);
+        connect(output_mgr->searchEngine(), &SearchEngine::matchesAdded,
+                this, &OutputView::handleMatchesAdded);
+    }
+    refresh();
+}
+
+void OutputView::setAutoScroll(bool enabled)
+{
+    auto_scroll = enabled;
+    refresh();
+}
+
+void OutputView::setSearchCursor(bool enabled)
+{
+    search_cursor = enabled;
+    occurence_offset = -1;
+    viewport()->update();
+}
+
+void OutputView::setDisplayMode(DisplayMode mode)
+{
+    if (mode == display_mode)
+        return;
+
+    display_mode = mode;
+    max_line_width = 0;
+    selection_anchor.line = -1;
+    selection_cursor = selection_anchor;
+
+    refresh();
+
+    // occurences are byte offsets, valid in both modes
+    if (occurence_offset >= 0)
+        showOccurence();
+}
+
+void OutputView::refresh()
+{
+    updateScrollBars();
+
+    if (auto_scroll)
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+
+    viewport()->update();
+}
+
+void OutputView::clear()
+{
+    start_offset = output_mgr ? output_mgr->buffer().size() : 0;
+    max_line_width = 0;
+    selection_anchor.line = -1;
+    selection_cursor = selection_anchor;
+
+    refresh();
+
+    // cleared occurences are not counted anymore
+    occurence_offset = -1;
+    if (output_mgr)
+        handleMatchesChanged();
+}
+
+void OutputView::previousOccurence()
+{
+    if (!output_mgr || occurence_offset < 0)
+        return;
+
+    const SearchEngine *engine = output_mgr->searchEngine();
+    const int first = engine->firstMatchFrom(start_offset);
+
+    // cyclic behaviour
+    int index = engine->firstMatchFrom(occurence_offset) - 1;
+    if (index < first)
+        index = engine->matches().size() - 1;
+    if (index < first)
+        return;
+
+    occurence_offset = engine->matches().at(index);
+    showOccurence();
+    viewport()->update();
+}
+
+void OutputView::nextOccurence()
+{
+    if (!output_mgr || occurence_offset < 0)
+        return;
+
+    const SearchEngine *engine = output_mgr->searchEngine();
+
+    // cyclic behaviour
+    int index = engine->firstMatchFrom(occurence_offset + 1);
+    if (index == engine->matches().size())
+        index = engine->firstMatchFrom(start_offset);
+    if (index == engine->matches().size())
+        return;
+
+    occurence_offset = engine->matches().at(index);
+    showOccurence();
+    viewport()->update();
+}
+
+void OutputView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    if (!output_mgr)
+        return;
+
+    QPainter painter(viewport());
+    const QFontMetrics metrics(font());
+    const int line_height = metrics.lineSpacing();
+    const int char_width = metrics.width(QLatin1Char('x'));
+    const int x0 = MARGIN - horizontalScrollBar()->value();
+
+    // ordered selection bounds
+    TextPos sel_start = selection_anchor, sel_end = selection_cursor;
+    if (sel_end < sel_start)
+        qSwap(sel_start, sel_end);
+    const bool has_selection = sel_start < sel_end;
+
+    const qint64 first = firstLine() + verticalScrollBar()->value();
+    const qint64 last = qMin(firstLine() + lineCount(),
+                             first + viewport()->height() / line_height + 1);
+    const int prev_max_line_width = max_line_width;
+
+    // occurences are highlighted once the search is over
+    const SearchEngine *engine = output_mgr->searchEngine();
+    const QVector<qint64> &matches = engine->matches();
+    const int search_length = engine->isSearching() ? 0 : engine->pattern().size();
+
+    for (qint64 line = first; line < last; ++line)
+    {
+        const qint64 line_offset = lineOffset(line);
+        const QByteArray data = display_mode == TextMode ?
+                    output_mgr->lineData(line, MAX_LINE_LENGTH, start_offset) : QByteArray();
+        const QString text = display_mode == TextMode ? displayText(data) : hexRow(line_offset);
+        const int y = (line - first) * line_height;
+
+        max_line_width = qMax(max_line_width, text.length() * char_width);
+
+        if (has_selection && sel_start.line <= line && line <= sel_end.line)
+        {
+            const int from = line == sel_start.line ? qMin(sel_start.column, text.length()) : 0;
+            const int to = line == sel_end.line ? qMin(sel_end.column, text.length()) : text.length();
+            painter.fillRect(x0 + from * char_width, y, (to - from) * char_width, line_height,
+                             palette().highlight());
+        }
+
+        if (search_length > 0)
+        {
+            // occurences overlapping this line, including one started on previous line
+            const qint64 line_end = line_offset +
+                    (display_mode == TextMode ? data.size() : HEX_ROW_BYTES);
+            for (int i = engine->firstMatchFrom(qMax(start_offset, line_offset - search_length + 1));
+                 i < matches.size() && matches.at(i) < line_end; ++i)
+            {
+                const qint64 match = matches.at(i);
+                const Qt::GlobalColor color = match == occurence_offset ?
+                            CURSOR_SEARCHRESULT_BACKCOL : SEARCHRESULT_BACKCOL;
+
+                if (display_mode == TextMode)
+                {
+                    int from, to;
+                    rangeColumns(data, line_offset, match, match + search_length, &from, &to);
+                    painter.fillRect(x0 + from * char_width, y, (to - from) * char_width,
+                                     line_height, color);
+                }
+                else
+                {
+                    // both hex cells and ascii chars
+                    const int from = qMax(match, line_offset) - line_offset;
+                    const int to = qMin(match + search_length, line_end) - line_offset;
+                    painter.fillRect(x0 + hexColumn(from) * char_width, y,
+                                     (hexColumn(to - 1) + 2 - hexColumn(from)) * char_width,
+                                     line_height, color);
+                    painter.fillRect(x0 + (HEX_ASCII_COLUMN + from) * char_width, y,
+                                     (to - from) * char_width, line_height, color);
+                }
+            }
+        }
+
+        painter.drawText(x0, y + metrics.ascent(), text);
+    }
+
+    if (max_line_width != prev_max_line_width)
+        updateScrollBars();
+}
+
+void OutputView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    // stay at the end if we were there
+    const bool at_end = verticalScrollBar()->value() == verticalScrollBar()->maximum();
+    updateScrollBars();
+    if (at_end)
+        verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void OutputView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        // start a new selection
+        selection_anchor = selection_cursor = posAt(event->pos());
+        viewport()->update();
+    }
+    else
+    {
+        QAbstractScrollArea::mousePressEvent(event);
+    }
+}
+
+void OutputView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+    {
+        selection_cursor = posAt(event->pos());
+        viewport()->update();
+    }
+    else
+    {
+        QAbstractScrollArea::mouseMoveEvent(event);
+    }
+}
+
+void OutputView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy))
+    {
+        const QString text = selectedText();
+        if (!text.isEmpty())
+            QApplication::clipboard()->setText(text);
+        return;
+    }
+
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void OutputView::handleMatchesChanged()
+{
+    const SearchEngine *engine = output_mgr->searchEngine();
+
+    if (engine->pattern().isEmpty())
+    {
+        occurence_offset = -1;
+        viewport()->update();
+        emit totalOccurencesChanged(-1);
+        return;
+    }
+
+    // wait for the end of the search
+    if (engine->isSearching())
+    {
+        viewport()->update();
+        return;
+    }
+
+    // only count occurences that have not been cleared
+    const QVector<qint64> &matches = engine->matches();
+    const int first = engine->firstMatchFrom(start_offset);
+    const int total = matches.size() - first;
+
+    if (total > 0 && search_cursor)
+    {
+        // first occurence following current one, or top of the view if none
+        int index = engine->firstMatchFrom(occurence_offset >= start_offset ?
+                                               occurence_offset : topOffset());
+        if (index == matches.size())
+            index = first;
+
+        occurence_offset = matches.at(index);
+        showOccurence();
+    }
+    else
+    {
+        occurence_offset = -1;
+    }
+
+    viewport()->update();
+    emit totalOccurencesChanged(total);
+}
+
+void OutputView::handleMatchesAdded()
+{
+    const SearchEngine *engine = output_mgr->searchEngine();
+    const int first = engine->firstMatchFrom(start_offset);
+    const int total = engine->matches().size() - first;
+
+    // first occurence becomes current one, but stay with received data
+    if (occurence_offset < 0 && total > 0 && search_cursor)
+        occurence_offset = engine->matches().at(first);
+
+    viewport()->update();
+    emit totalOccurencesChanged(total);
+}
+
+qint64 OutputView::firstLine() const
+{
+    // hex rows are numbered from start_offset
+    if (!output_mgr || display_mode == HexMode)
+        return 0;
+
+    // OutputManager may have been cleared since
+    return output_mgr->lines().lineAt(qMin(start_offset, output_mgr->buffer().size()));
+}
+
+qint64 OutputView::lineCount() const
+{
+    if (!output_mgr)
+        return 0;
+
+    if (display_mode == HexMode)
+    {
+        const qint64 size = output_mgr->buffer().size() - start_offset;
+        return qMax<qint64>(0, (size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES);
+    }
+
+    return output_mgr->lines().lineCount() - firstLine();
+}
+
+qint64 OutputView::lineOffset(qint64 line) const
+{
+    if (display_mode == HexMode)
+        return start_offset + line * HEX_ROW_BYTES;
+
+    return qMax(output_mgr->lines().lineStart(line), start_offset);
+}
+
+qint64 OutputView::topOffset() const
+{
+    return output_mgr ? lineOffset(firstLine() + verticalScrollBar()->value()) : 0;
+}
+
+QString OutputView::lineText(qint64 line) const
+{
+    if (display_mode == HexMode)
+        return hexRow(lineOffset(line));
+
+    return displayText(output_mgr->lineData(line, MAX_LINE_LENGTH, start_offset));
+}
+
+QString OutputView::displayText(const QByteArray &data) const
+{
+    const QString text = output_mgr->decodeLine(data);
+
+    // fast path, no control chars
+    bool has_control = false;
+    for (const QChar c : text)
+    {
+        if (c.unicode() < 0x20)
+        {
+            has_control = true;
+            break;
+        }
+    }
+    if (!has_control)
+        return text;
+
+    // expand tabs, drop other control chars
+    QString expanded;
+    expanded.reserve(text.size() + TAB_WIDTH);
+    for (const QChar c : text)
+    {
+        if (c == QLatin1Char('\t'))
+            expanded.append(QString(TAB_WIDTH - expanded.size() % TAB_WIDTH, QLatin1Char(' ')));
+        else if (c.unicode() >= 0x20)
+            expanded.append(c);
+    }
+    return expanded;
+}
+
+void OutputView::rangeColumns(const QByteArray &data, qint64 data_offset, qint64 start, qint64 end,
+                              int *from, int *to) const
+{
+    // columns depend on the chars before the range: multi-byte sequences, tabs
+    const qint64 start_index = qBound<qint64>(0, start - data_offset, data.size());
+    const qint64 end_index = qBound<qint64>(0, end - data_offset, data.size());
+    *from = displayText(data.left(start_index)).length();
+    *to = displayText(data.left(end_index)).length();
+}
+
+QString OutputView::hexRow(qint64 offset) const
+{
+    const HexTable &table = hexTable();
+    const QByteArray data = output_mgr->buffer().read(offset, HEX_ROW_BYTES);
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+
+    QString row(HEX_ROW_LENGTH, QLatin1Char(' '));
+    QChar *out = row.data();
+
+    for (int i = 0; i < HEX_OFFSET_DIGITS; ++i)
+        out[i] = table.hex[(offset >> (4 * (HEX_OFFSET_DIGITS - 1 - i))) & 0xF][1];
+
+    for (int i = 0; i < data.size(); ++i)
+    {
+        QChar *cell = out + hexColumn(i);
+        cell[0] = table.hex[bytes[i]][0];
+        cell[1] = table.hex[bytes[i]][1];
+        out[HEX_ASCII_COLUMN + i] = table.ascii[bytes[i]];
+    }
+
+    out[HEX_ASCII_COLUMN - 1] = QLatin1Char('|');
+    out[HEX_ASCII_COLUMN + HEX_ROW_BYTES] = QLatin1Char('|');
+
+    return row;
+}
+
+int OutputView::visibleLines() const
+{
+    return qMax(1, viewport()->height() / QFontMetrics(font()).lineSpacing());
+}
+
+void OutputView::updateScrollBars()
+{
+    const int rows = visibleLines();
+    verticalScrollBar()->setRange(0, qBound<qint64>(0, lineCount() - rows, INT_MAX));
+    verticalScrollBar()->setPageStep(rows);
+
+    const int width = viewport()->width();
+    horizontalScrollBar()->setRange(0, qMax(0, max_line_width + 2 * MARGIN - width));
+    horizontalScrollBar()->setPageStep(width);
+}
+
+OutputView::TextPos OutputView::posAt(const QPoint &point) const
+{
+    const QFontMetrics metrics(font());
+    const int char_width = metrics.width(QLatin1Char('x'));
+    const int x = point.x() - MARGIN + horizontalScrollBar()->value();
+
+    TextPos pos;
+    pos.line = qBound<qint64>(firstLine(),
+                              firstLine() + verticalScrollBar()->value() + point.y() / metrics.lineSpacing(),
+                              firstLine() + lineCount() - 1);
+    pos.column = qMax(0, (x + char_width / 2) / char_width);
+    return pos;
+}
+
+void OutputView::showOccurence()
+{
+    const int char_width = QFontMetrics(font()).width(QLatin1Char('x'));
+    const int search_length = output_mgr->searchEngine()->pattern().size();
+
+    // line and columns of occurence
+    qint64 line;
+    int from, to;
+    if (display_mode == HexMode)
+    {
+        line = (occurence_offset - start_offset) / HEX_ROW_BYTES;
+        const int index = (occurence_offset - start_offset) % HEX_ROW_BYTES;
+        from = hexColumn(index);
+        to = HEX_ASCII_COLUMN + qMin(index + search_length, HEX_ROW_BYTES);
+    }
+    else
+    {
+        line = output_mgr->lines().lineAt(occurence_offset);
+        rangeColumns(output_mgr->lineData(line, MAX_LINE_LENGTH, start_offset), lineOffset(line),
+                     occurence_offset, occurence_offset + search_length, &from, &to);
+    }
+
+    // make sure horizontal range covers occurence before scrolling to it
+    max_line_width = qMax(max_line_width, to * char_width);
+    updateScrollBars();
+
+    const qint64 row = line - firstLine();
+    const int rows = visibleLines();
+    QScrollBar *vbar = verticalScrollBar();
+    if (row < vbar->value() || row >= vbar->value() + rows)
+        vbar->setValue(qBound<qint64>(0, row - rows / 2, INT_MAX));
+
+    const int width = viewport()->width() - 2 * MARGIN;
+    QScrollBar *hbar = horizontalScrollBar();
+    if (from * char_width < hbar->value() || to * char_width > hbar->value() + width)
+        hbar->setValue(from * char_width - width / 2);
+}
+
+QString OutputView::selectedText() const
+{
+    TextPos start = selection_anchor, end = selection_cursor;
+    if (end < start)
+        qSwap(start, end);
+    if (!(start < end) || start.line < firstLine())
+        return QString();
+
+    QString text;
+    for (qint64 line = start.line; line <= end.line; ++line)
+    {
+        const QString line_text = lineText(line);
+        const int from = line == start.line ? qMin(start.column, line_text.length()) : 0;
+        const int to = line == end.line ? qMin(end.column, line_text.length()) : line_text.length();
+
+        if (line != start.line)
+            text.append(QLatin1Char('\n'));
+        text.append(line_text.midRef(from, to - from));
+    }
+    return text;
+}
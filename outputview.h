@@ -0,0 +1,245 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief OutputView class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef OUTPUTVIEW_H
+#define OUTPUTVIEW_H
+
+#include <QAbstractScrollArea>
+
+class OutputManager;
+
+/**
+ * \brief read-only view of the data received in current session
+ *
+ * unlike a QPlainTextEdit, the view holds no copy of the text: each time it
+ * is painted, the visible lines are read from OutputManager buffer through
+ * its line index and decoded. Memory and painting cost only depend on the
+ * view size, not on the amount of data received.
+ *
+ * lines are not wrapped, a horizontal scroll bar shows up for long lines.
+ *
+ * in hex mode, the view shows rows of 16 bytes, formatted on demand from the
+ * raw data. Selection then applies to the formatted rows.
+ *
+ * search results come from OutputManager SearchEngine: only the occurences
+ * falling in visible lines are looked up and highlighted.
+ *
+ * several views may display the same OutputManager, received data being
+ * stored, indexed and searched once for all of them.
+ */
+class OutputView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    /**
+     * \brief how received data is displayed
+     */
+    enum DisplayMode {
+        TextMode,
+        HexMode
+    };
+
+private:
+
+    /**
+     * \brief position of a char in the view
+     */
+    struct TextPos
+    {
+        qint64  line;
+        int     column;
+
+        bool operator < (const TextPos &other) const
+        {
+            return line < other.line || (line == other.line && column < other.column);
+        }
+    };
+
+    /// source of displayed data
+    const OutputManager *output_mgr;
+
+    /// text or hex dump
+    DisplayMode display_mode;
+
+    /// offset of first displayed byte, data before it has been cleared
+    qint64      start_offset;
+
+    /// if set, the view scrolls to the end when lines are added
+    bool        auto_scroll;
+
+    /// width of widest line painted so far, in pixels
+    int         max_line_width;
+
+    /// offset of current occurence of search string, -1 if none
+    qint64      occurence_offset;
+
+    /// if set, the view has a current occurence and moves to it
+    bool        search_cursor;
+
+    /// selection start, where mouse button has been pressed
+    TextPos     selection_anchor;
+
+    /// selection end, where mouse button is
+    TextPos     selection_cursor;
+
+public:
+    explicit OutputView(QWidget *parent = 0);
+
+    /**
+     * \brief set the source of displayed data
+     */
+    void setOutputManager(const OutputManager *mgr);
+
+    /**
+     * \brief enable/disable scrolling to the end when lines are added
+     */
+    void setAutoScroll(bool enabled);
+
+    /**
+     * \brief enable/disable the current occurence of search string, without
+     *  it occurences are highlighted but the view never moves to them
+     */
+    void setSearchCursor(bool enabled);
+
+    /**
+     * \brief switch between text and hex dump
+     */
+    void setDisplayMode(DisplayMode mode);
+
+    /**
+     * \brief take new data into account and repaint
+     */
+    void refresh();
+
+    /**
+     * \brief hide all data received so far
+     */
+    void clear();
+
+    /**
+     * \brief move to previous occurence of search string
+     */
+    void previousOccurence();
+
+    /**
+     * \brief move to next occurence of search string
+     */
+    void nextOccurence();
+
+signals:
+
+    /**
+     * \brief signal emitted when total number of search string occurences
+     * has changed
+     * \param total_occurences number of occurences:
+     *     * -1: no search string
+     *     *  0: search string defined but 0 occurences found
+     *     *  n: n occurences of search string
+     */
+    void totalOccurencesChanged(int total_occurences);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+
+private:
+
+    /**
+     * \brief handle changes of search results: move to the first occurence
+     *  following current one
+     */
+    void handleMatchesChanged();
+
+    /**
+     * \brief handle occurences found in appended data: update the total
+     *  without moving the view
+     */
+    void handleMatchesAdded();
+
+    /**
+     * \brief return the first displayed line, or hex row
+     */
+    qint64 firstLine() const;
+
+    /**
+     * \brief return the number of displayed lines, or hex rows
+     */
+    qint64 lineCount() const;
+
+    /**
+     * \brief return the offset of the first displayed byte of a line or hex row
+     */
+    qint64 lineOffset(qint64 line) const;
+
+    /**
+     * \brief return the offset of the first byte displayed at the top of the view
+     */
+    qint64 topOffset() const;
+
+    /**
+     * \brief return the text of a displayed line, tabs expanded, or a hex row
+     */
+    QString lineText(qint64 line) const;
+
+    /**
+     * \brief decode raw data, expand tabs and drop other control chars
+     */
+    QString displayText(const QByteArray &data) const;
+
+    /**
+     * \brief return the columns covered by a range of bytes of a text line
+     * \param data         raw data of the line
+     * \param data_offset  offset of first byte of data
+     * \param start        range start offset
+     * \param end          range end offset
+     * \param from         first column, set
+     * \param to           column following last one, set
+     */
+    void rangeColumns(const QByteArray &data, qint64 data_offset, qint64 start, qint64 end,
+                      int *from, int *to) const;
+
+    /**
+     * \brief format a hex dump row
+     * \param offset offset of first byte of the row
+     */
+    QString hexRow(qint64 offset) const;
+
+    /**
+     * \brief return the number of fully visible lines
+     */
+    int visibleLines() const;
+
+    /**
+     * \brief update scroll bars ranges
+     */
+    void updateScrollBars();
+
+    /**
+     * \brief return the char position at given viewport coordinates
+     */
+    TextPos posAt(const QPoint &point) const;
+
+    /**
+     * \brief scroll so that current occurence is visible
+     */
+    void showOccurence();
+
+    /**
+     * \brief return selected text
+     */
+    QString selectedText() const;
+};
+
+#endif // OUTPUTVIEW_H
@@ -0,0 +1,169 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ReplaySource class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "replaysource.h"
+#include "capturefile.h"
+#include "chunkring.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFile>
+
+/// size of chunks read from raw dump files
+const int RAW_CHUNK_SIZE = 16 * 1024;
+
+/// maximum size of a chunk pushed into the ring
+const int MAX_PUSH_SIZE = 64 * 1024;
+
+/// longest sleep between two checks of the quit flag, in microseconds
+const qint64 MAX_SLEEP_USECS = 50000;
+
+/// sleep while waiting for room in the ring, in microseconds
+const int RING_FULL_SLEEP_USECS = 500;
+
+ReplaySource::ReplaySource(ChunkRing *ring, const QString &filename, double speed) :
+    QObject(0),
+    ring(ring),
+    filename(filename),
+    speed(speed),
+    thread(0),
+    quit_requested(0),
+    bytes_replayed(0)
+{
+}
+
+ReplaySource::~ReplaySource()
+{
+    // the thread may still be returning from performReplay()
+    if (thread)
+    {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+}
+
+void ReplaySource::start()
+{
+    thread = new QThread;
+    moveToThread(thread);
+
+    connect(thread, &QThread::started, this, &ReplaySource::performReplay);
+
+    thread->start();
+}
+
+void ReplaySource::stop()
+{
+    quit_requested.storeRelease(1);
+}
+
+void ReplaySource::wait()
+{
+    if (thread)
+        thread->wait();
+}
+
+void ReplaySource::performReplay()
+{
+    const bool ok = CaptureReader::isCaptureFile(filename) ? replayCapture() : replayRaw();
+
+    // move back to main thread so that the instance can be deleted from
+    // there, the destructor waits for this thread to be over
+    moveToThread(QCoreApplication::instance()->thread());
+    emit replayEnded(ok, bytes_replayed);
+
+    thread->quit();
+}
+
+bool ReplaySource::replayCapture()
+{
+    CaptureReader reader;
+    if (!reader.open(filename))
+        return false;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    CaptureReader::Record record;
+    qint64 offset = reader.firstRecord(), next;
+    qint64 first_timestamp = -1;
+
+    while (reader.readRecord(offset, &record, &next))
+    {
+        offset = next;
+
+        if (record.type != CaptureReceived)
+            continue;
+
+        if (first_timestamp < 0)
+            first_timestamp = record.timestamp;
+
+        if (speed > 0)
+        {
+            // wait until record is due, checking quit flag regularly
+            const qint64 due_ns = (record.timestamp - first_timestamp) / speed;
+            qint64 wait_us;
+            while ((wait_us = (due_ns - elapsed.nsecsElapsed()) / 1000) > 0)
+            {
+                if (quit_requested.loadAcquire())
+                    return true;
+                QThread::usleep(qMin(wait_us, MAX_SLEEP_USECS));
+            }
+        }
+
+        if (!pushChunk(record.data, record.length))
+            break;
+    }
+
+    return true;
+}
+
+bool ReplaySource::replayRaw()
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray chunk;
+    while (!(chunk = file.read(RAW_CHUNK_SIZE)).isEmpty())
+    {
+        if (!pushChunk(chunk.constData(), chunk.size()))
+            break;
+    }
+
+    return true;
+}
+
+bool ReplaySource::pushChunk(const char *data, int len)
+{
+    while (len > 0)
+    {
+        const int size = qMin(len, MAX_PUSH_SIZE);
+        while (!ring->push(data, size, ChunkRing::timestamp()))
+        {
+            // consumer is late, let it catch up
+            if (quit_requested.loadAcquire())
+                return false;
+            QThread::usleep(RING_FULL_SLEEP_USECS);
+        }
+
+        data += size;
+        len -= size;
+        bytes_replayed += size;
+
+        if (ring->requestNotify())
+            emit dataAvailable();
+    }
+
+    return !quit_requested.loadAcquire();
+}
@@ -0,0 +1,129 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ReplaySource class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <QObject>
+#include <QAtomicInt>
+
+class ChunkRing;
+class QThread;
+
+/**
+ * \brief feed a saved dump file back into the reception pipeline
+ *
+ * the replay thread takes the place of the serial reader: it pushes the
+ * dump content into the ring buffer drained by SessionManager, so that
+ * replayed data follows exactly the same path as data coming from a port.
+ *
+ * capture dumps are replayed at their original timing divided by the
+ * requested speed factor, raw and text dumps have no timing information
+ * and are always replayed as fast as possible.
+ */
+class ReplaySource : public QObject
+{
+    Q_OBJECT
+
+private:
+
+    /// ring buffer to fill
+    ChunkRing   *ring;
+
+    /// dump file to replay
+    QString     filename;
+
+    /// speed factor, 0 means as fast as possible
+    double      speed;
+
+    /// thread in which the replay is performed, owned by the instance
+    QThread     *thread;
+
+    /// if non zero, the replay should stop as soon as possible
+    QAtomicInt  quit_requested;
+
+    /// amount of bytes pushed so far
+    qint64      bytes_replayed;
+
+public:
+
+    /**
+     * \brief create a replay source
+     * \param ring      ring buffer to fill, no other producer must be active
+     * \param filename  dump file to replay
+     * \param speed     speed factor: 1 for original timing, 0 for as fast as possible
+     */
+    ReplaySource(ChunkRing *ring, const QString &filename, double speed);
+
+    /**
+     * \brief wait for the replay thread to end, then delete it
+     * \note call stop() first, unless the replay is already over
+     */
+    ~ReplaySource();
+
+    /**
+     * \brief start the replay
+     * \note this method returns immediately, the replay is performed in another thread
+     */
+    void start();
+
+    /**
+     * \brief ask the replay to stop as soon as possible
+     * \note replayEnded() is emitted once stopped
+     */
+    void stop();
+
+    /**
+     * \brief block until the replay thread has ended
+     */
+    void wait();
+
+private:
+
+    /**
+     * \brief replay the whole file, in replay thread
+     */
+    void performReplay();
+
+    /**
+     * \brief replay a capture dump file
+     * \return false on file error
+     */
+    bool replayCapture();
+
+    /**
+     * \brief replay a raw or text dump file
+     * \return false on file error
+     */
+    bool replayRaw();
+
+    /**
+     * \brief push a chunk into the ring, waiting for room if needed
+     * \return false if the replay has been stopped meanwhile
+     */
+    bool pushChunk(const char *data, int len);
+
+signals:
+
+    /**
+     * \brief signal emitted when chunks have been pushed in the ring
+     */
+    void dataAvailable();
+
+    /**
+     * \brief signal emitted when the replay is over
+     * \param ok     false if the file could not be read
+     * \param bytes  amount of bytes replayed
+     */
+    void replayEnded(bool ok, qint64 bytes);
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,153 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SearchEngine class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "searchengine.h"
+#include "searchworker.h"
+#include "bytestore.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+SearchEngine::SearchEngine(const ByteStore *store, QObject *parent) :
+    QObject(parent),
+    store(store),
+    searched_end(0),
+    next_allowed(0),
+    generation(0),
+    searching(false)
+{
+    qRegisterMetaType<ByteStore::Snapshot>("ByteStore::Snapshot");
+    qRegisterMetaType<QVector<qint64> >("QVector<qint64>");
+
+    search_thread = new QThread(this);
+    worker = new SearchWorker();
+    worker->moveToThread(search_thread);
+    connect(search_thread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &SearchWorker::searchDone, this, &SearchEngine::handleSearchDone);
+    search_thread->start();
+}
+
+SearchEngine::~SearchEngine()
+{
+    // abandon running search
+    worker->setLatestGeneration(++generation);
+
+    search_thread->quit();
+    search_thread->wait();
+}
+
+void SearchEngine::setPattern(const QByteArray &pattern)
+{
+    // fold ASCII letters only, other bytes may be part of multi-byte chars
+    _pattern = pattern;
+    for (int i = 0; i < _pattern.size(); ++i)
+    {
+        if (_pattern.at(i) >= 'A' && _pattern.at(i) <= 'Z')
+            _pattern[i] = _pattern.at(i) + ('a' - 'A');
+    }
+    _matches.clear();
+    searched_end = next_allowed = 0;
+
+    // running search, if any, is abandoned
+    worker->setLatestGeneration(++generation);
+    searching = !_pattern.isEmpty();
+
+    if (searching)
+    {
+        QMetaObject::invokeMethod(worker, "search", Qt::QueuedConnection,
+                                  Q_ARG(int, generation),
+                                  Q_ARG(QByteArray, _pattern),
+                                  Q_ARG(ByteStore::Snapshot, store->snapshot()));
+    }
+
+    emit matchesChanged();
+}
+
+const QByteArray& SearchEngine::pattern() const
+{
+    return _pattern;
+}
+
+bool SearchEngine::isSearching() const
+{
+    return searching;
+}
+
+const QVector<qint64>& SearchEngine::matches() const
+{
+    return _matches;
+}
+
+int SearchEngine::firstMatchFrom(qint64 offset) const
+{
+    return std::lower_bound(_matches.constBegin(), _matches.constEnd(), offset)
+        - _matches.constBegin();
+}
+
+void SearchEngine::dataAppended()
+{
+    if (searchAppended())
+        emit matchesAdded();
+}
+
+void SearchEngine::clear()
+{
+    // pattern stays, next data is searched from the start
+    _matches.clear();
+    searched_end = next_allowed = 0;
+    worker->setLatestGeneration(++generation);
+    searching = false;
+
+    emit matchesChanged();
+}
+
+void SearchEngine::handleSearchDone(int search_generation, const QVector<qint64> &matches, qint64 end)
+{
+    // results of an abandoned search
+    if (search_generation != generation)
+        return;
+
+    _matches = matches;
+    searched_end = end;
+    next_allowed = matches.isEmpty() ? 0 : matches.last() + _pattern.size();
+    searching = false;
+
+    // catch up with data received during the search
+    searchAppended();
+
+    emit matchesChanged();
+}
+
+bool SearchEngine::searchAppended()
+{
+    // the worker searches appended data until its search is over
+    if (_pattern.isEmpty() || searching)
+        return false;
+
+    const int count = _matches.size();
+    const qint64 end = store->size();
+
+    // start back in searched data, for occurences spanning its end
+    const qint64 start = qMax(next_allowed, searched_end - (_pattern.size() - 1));
+
+    // a segment at a time, each window overlapping the next one
+    for (qint64 offset = start; offset + _pattern.size() <= end; offset += ByteStore::SEGMENT_SIZE)
+    {
+        const QByteArray window = store->read(
+                    offset, qMin<qint64>(end - offset, ByteStore::SEGMENT_SIZE + _pattern.size() - 1));
+        SearchWorker::findMatches(reinterpret_cast<const uchar *>(window.constData()), window.size(),
+                                  _pattern, offset, &next_allowed, &_matches);
+    }
+
+    searched_end = end;
+    return _matches.size() != count;
+}
@@ -0,0 +1,142 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SearchEngine class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QObject>
+#include <QVector>
+
+class ByteStore;
+class SearchWorker;
+class QThread;
+
+/**
+ * \brief find occurences of a pattern in received data
+ *
+ * data is scanned by a SearchWorker in a dedicated thread, so that the GUI
+ * stays responsive whatever the amount of data. Once the scan is over, the
+ * sorted offsets of all occurences are cached: moving from an occurence to
+ * the next one, or finding the occurences displayed in a view, is a binary
+ * search in this list.
+ *
+ * afterwards, the list is kept up to date as data is appended: only new
+ * bytes, plus the tail of previous data for occurences spanning both, are
+ * scanned.
+ */
+class SearchEngine : public QObject
+{
+    Q_OBJECT
+
+private:
+
+    /// searched data
+    const ByteStore *store;
+
+    /// current pattern, lower case, empty if none
+    QByteArray      _pattern;
+
+    /// offsets of occurences of pattern, sorted
+    QVector<qint64> _matches;
+
+    /// offset following data searched so far
+    qint64          searched_end;
+
+    /// next occurence must start at or after this offset, occurences don't overlap
+    qint64          next_allowed;
+
+    /// identifier of latest requested search
+    int             generation;
+
+    /// set while the worker is scanning for current pattern
+    bool            searching;
+
+    /// search worker, living in search_thread
+    SearchWorker    *worker;
+
+    /// thread scanning data
+    QThread         *search_thread;
+
+public:
+
+    /**
+     * \brief create a search engine
+     * \param store   data to search, must outlive the engine
+     * \param parent  parent object
+     */
+    explicit SearchEngine(const ByteStore *store, QObject *parent = 0);
+    ~SearchEngine();
+
+    /**
+     * \brief set the pattern to find, and start searching it
+     * \param pattern  pattern, ASCII letters match regardless of case,
+     *                 empty to stop searching
+     */
+    void setPattern(const QByteArray &pattern);
+
+    /**
+     * \brief return current pattern, lower case
+     */
+    const QByteArray& pattern() const;
+
+    /**
+     * \brief return true while data is being scanned
+     */
+    bool isSearching() const;
+
+    /**
+     * \brief return the offsets of found occurences, sorted
+     */
+    const QVector<qint64>& matches() const;
+
+    /**
+     * \brief return the index of the first occurence at or after offset
+     * \return index in matches(), matches().size() if none
+     */
+    int firstMatchFrom(qint64 offset) const;
+
+    /**
+     * \brief search data appended to the store since last call
+     */
+    void dataAppended();
+
+    /**
+     * \brief forget found occurences, searched data has been cleared
+     */
+    void clear();
+
+signals:
+
+    /**
+     * \brief signal emitted when the list of occurences has changed
+     */
+    void matchesChanged();
+
+    /**
+     * \brief signal emitted when occurences have been found in appended data
+     */
+    void matchesAdded();
+
+private:
+
+    /**
+     * \brief search data following searched_end
+     * \return true if occurences have been found
+     */
+    bool searchAppended();
+
+    /**
+     * \brief handle searchDone signal from the worker
+     */
+    void handleSearchDone(int search_generation, const QVector<qint64> &matches, qint64 end);
+};
+
+#endif // SEARCHENGINE_H
@@ -0,0 +1,154 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SearchWorker class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "searchworker.h"
+
+#include <QFile>
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * \brief return lower case of ASCII letters, other bytes unchanged
+ */
+static inline uchar foldCase(uchar c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/**
+ * \brief find next byte equal to lower or upper
+ * \return pointer to the byte, or end if none
+ */
+static const uchar *findCandidate(const uchar *p, const uchar *end, uchar lower, uchar upper)
+{
+#ifdef __SSE2__
+    // 16 bytes at a time
+    const __m128i lower_mask = _mm_set1_epi8(lower);
+    const __m128i upper_mask = _mm_set1_epi8(upper);
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const int mask = _mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, lower_mask), _mm_cmpeq_epi8(chunk, upper_mask)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+
+    if (lower == upper)
+    {
+        const void *found = memchr(p, lower, end - p);
+        return found ? static_cast<const uchar *>(found) : end;
+    }
+
+    while (p < end && *p != lower && *p != upper)
+        ++p;
+    return p;
+}
+
+SearchWorker::SearchWorker() :
+    QObject(0),
+    latest_generation(0)
+{
+}
+
+void SearchWorker::findMatches(const uchar *data, int len, const QByteArray &pattern,
+                               qint64 base, qint64 *next_allowed, QVector<qint64> *matches)
+{
+    const uchar *pat = reinterpret_cast<const uchar *>(pattern.constData());
+    const int pat_len = pattern.size();
+    if (len < pat_len)
+        return;
+
+    const uchar first = pat[0];
+    const uchar first_upper = first >= 'a' && first <= 'z' ? first - ('a' - 'A') : first;
+
+    // one past the last position where an occurence may start
+    const uchar *end = data + len - pat_len + 1;
+    const uchar *p = data;
+
+    // a match may move p past end
+    while (p < end && (p = findCandidate(p, end, first, first_upper)) != end)
+    {
+        int i = 1;
+        while (i < pat_len && foldCase(p[i]) == pat[i])
+            ++i;
+
+        const qint64 offset = base + (p - data);
+        if (i == pat_len && offset >= *next_allowed)
+        {
+            matches->append(offset);
+            *next_allowed = offset + pat_len;
+            p += pat_len;
+        }
+        else
+        {
+            ++p;
+        }
+    }
+}
+
+void SearchWorker::setLatestGeneration(int generation)
+{
+    latest_generation.storeRelease(generation);
+}
+
+void SearchWorker::search(int generation, const QByteArray &pattern,
+                          const ByteStore::Snapshot &snapshot)
+{
+    QVector<qint64> matches;
+
+    QFile spill_file(snapshot.spill_filename);
+    if (snapshot.spilled > 0 && !spill_file.open(QIODevice::ReadOnly))
+        qWarning("can't read %s", qPrintable(snapshot.spill_filename));
+
+    // tail of previous segment, for occurences spanning two segments
+    QByteArray tail;
+    qint64 segment_start = 0, next_allowed = 0;
+
+    const int count = snapshot.spilled + snapshot.segments.size();
+    for (int i = 0; i < count; ++i)
+    {
+        // a newer search has been requested, drop this one
+        if (latest_generation.loadAcquire() != generation)
+            return;
+
+        QByteArray segment;
+        if (i < snapshot.spilled)
+        {
+            spill_file.seek(qint64(i) * ByteStore::SEGMENT_SIZE);
+            segment = spill_file.read(ByteStore::SEGMENT_SIZE);
+            if (segment.size() != ByteStore::SEGMENT_SIZE)
+                segment = QByteArray(ByteStore::SEGMENT_SIZE, '\0');
+        }
+        else
+        {
+            segment = snapshot.segments.at(i - snapshot.spilled);
+        }
+
+        QByteArray window = segment;
+        if (!tail.isEmpty())
+            window.prepend(tail);
+
+        findMatches(reinterpret_cast<const uchar *>(window.constData()), window.size(),
+                    pattern, segment_start - tail.size(), &next_allowed, &matches);
+
+        tail = window.right(pattern.size() - 1);
+        segment_start += segment.size();
+    }
+
+    emit searchDone(generation, matches, segment_start);
+}
@@ -0,0 +1,78 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SearchWorker class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include "bytestore.h"
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QVector>
+
+/**
+ * \brief scan received data for a pattern, in a worker thread
+ *
+ * the scan works on a ByteStore snapshot, so that data can keep on being
+ * received meanwhile. ASCII letters match regardless of their case.
+ */
+class SearchWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+
+    /// generation of the latest requested search, older ones are abandoned
+    QAtomicInt  latest_generation;
+
+public:
+
+    SearchWorker();
+
+    /**
+     * \brief abandon searches older than generation
+     * \note may be called from any thread
+     */
+    void setLatestGeneration(int generation);
+
+    /**
+     * \brief find all non-overlapping occurences of pattern
+     * \param generation search identifier, returned with the results
+     * \param pattern    pattern to find, lower case
+     * \param snapshot   data to search
+     */
+    Q_INVOKABLE void search(int generation, const QByteArray &pattern,
+                            const ByteStore::Snapshot &snapshot);
+
+    /**
+     * \brief find occurences of a lower case pattern in a buffer
+     * \param data          buffer
+     * \param len           buffer length
+     * \param pattern       pattern to find, lower case
+     * \param base          offset of buffer first byte
+     * \param next_allowed  occurences must start at or after this offset, updated
+     * \param matches       offsets of found occurences are appended here
+     */
+    static void findMatches(const uchar *data, int len, const QByteArray &pattern,
+                            qint64 base, qint64 *next_allowed, QVector<qint64> *matches);
+
+signals:
+
+    /**
+     * \brief signal emitted when a search is over
+     * \param generation search identifier
+     * \param matches    offsets of occurences, sorted
+     * \param end        offset following searched data
+     */
+    void searchDone(int generation, const QVector<qint64> &matches, qint64 end);
+};
+
+#endif // SEARCHWORKER_H
@@ -0,0 +1,187 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SerialReader class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "serialreader.h"
+#include "chunkring.h"
+#include "dumpwriter.h"
+
+#include <QSerialPort>
+#include <QThread>
+#include <QTimer>
+
+/// maximum size of a chunk pushed into the ring
+const int MAX_CHUNK_SIZE = 64 * 1024;
+
+/// delay before trying again to push data when the ring is full
+const int RING_FULL_RETRY_MS = 2;
+
+/// amount of data scanned for triggers before performing the actions,
+/// bounds the time between an occurence and its action
+const int TRIGGER_SCAN_SIZE = 4096;
+
+SerialReader::SerialReader(ChunkRing *ring, DumpWriter *dump) :
+    QObject(0),
+    ring(ring),
+    serial(0),
+    home_thread(0),
+    dump(dump)
+{
+    retry_timer = new QTimer(this);
+    retry_timer->setSingleShot(true);
+    retry_timer->setInterval(RING_FULL_RETRY_MS);
+    connect(retry_timer, &QTimer::timeout, this, &SerialReader::drainPort);
+}
+
+void SerialReader::start(QSerialPort *port)
+{
+    Q_ASSERT_X(serial == 0, "SerialReader::start", "reader already started");
+
+    serial = port;
+    home_thread = port->thread();
+
+    // from now on, the serial port is only accessed from the reader thread
+    serial->moveToThread(thread());
+    QMetaObject::invokeMethod(this, "attachPort", Qt::QueuedConnection);
+}
+
+void SerialReader::stop()
+{
+    if (serial)
+        QMetaObject::invokeMethod(this, "detachPort", Qt::BlockingQueuedConnection);
+}
+
+bool SerialReader::isReading() const
+{
+    return serial != 0;
+}
+
+void SerialReader::write(const QByteArray &data)
+{
+    QMetaObject::invokeMethod(this, "writeData", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+}
+
+void SerialReader::setTriggers(const QVector<TriggerEngine::Trigger> &new_triggers)
+{
+    QMetaObject::invokeMethod(this, "installTriggers", Qt::QueuedConnection,
+                              Q_ARG(QVector<TriggerEngine::Trigger>, new_triggers));
+}
+
+void SerialReader::attachPort()
+{
+    // a new stream starts
+    triggers.reset();
+
+    connect(serial, &QSerialPort::readyRead, this, &SerialReader::drainPort);
+
+    // data may have been received while the port was moving between threads
+    drainPort();
+}
+
+void SerialReader::detachPort()
+{
+    retry_timer->stop();
+
+    // take what's already there, anything left stays in the port buffer
+    drainPort();
+
+    disconnect(serial, 0, this, 0);
+    serial->moveToThread(home_thread);
+    serial = 0;
+}
+
+void SerialReader::writeData(const QByteArray &data)
+{
+    if (serial)
+        serial->write(data);
+}
+
+void SerialReader::installTriggers(const QVector<TriggerEngine::Trigger> &new_triggers)
+{
+    triggers.setTriggers(new_triggers);
+}
+
+void SerialReader::drainPort()
+{
+    if (!serial)
+        return;
+
+    const qint64 timestamp = ChunkRing::timestamp();
+    bool pushed = false;
+
+    qint64 available;
+    while ((available = serial->bytesAvailable()) > 0)
+    {
+        const int room = qMin(ring->maxPushSize(), MAX_CHUNK_SIZE);
+        if (room == 0)
+        {
+            // consumer is late, data stays buffered in QSerialPort meanwhile
+            retry_timer->start();
+            break;
+        }
+
+        QByteArray chunk(serial->read(qMin<qint64>(room, available)));
+        handleChunk(chunk, timestamp);
+        ring->push(chunk.constData(), chunk.size(), timestamp);
+        pushed = true;
+    }
+
+    if (pushed && ring->requestNotify())
+        emit dataAvailable();
+}
+
+void SerialReader::handleChunk(const QByteArray &chunk, qint64 timestamp)
+{
+    if (triggers.isEmpty())
+    {
+        dump->write(chunk, timestamp, CaptureReceived);
+        return;
+    }
+
+    // data preceding a dump action, occurence included, is written before it
+    int dumped = 0;
+
+    QVector<TriggerEngine::Match> matches;
+    for (int base = 0; base < chunk.size(); base += TRIGGER_SCAN_SIZE)
+    {
+        matches.clear();
+        triggers.scan(chunk.constData() + base, qMin(TRIGGER_SCAN_SIZE, chunk.size() - base),
+                      &matches);
+
+        for (const TriggerEngine::Match &match : matches)
+        {
+            const TriggerEngine::Trigger &trigger = triggers.trigger(match.trigger);
+            switch (trigger.action)
+            {
+                case TriggerEngine::Send:
+                    serial->write(trigger.data);
+                    // write as much as possible now rather than from the event loop
+                    serial->flush();
+                    dump->write(trigger.data, ChunkRing::timestamp(), CaptureTransmitted);
+                    break;
+
+                case TriggerEngine::StartDump:
+                case TriggerEngine::StopDump:
+                    dump->write(chunk.mid(dumped, base + match.end - dumped), timestamp,
+                                CaptureReceived);
+                    dumped = base + match.end;
+                    dump->setPaused(trigger.action == TriggerEngine::StopDump);
+                    break;
+
+                case TriggerEngine::Mark:
+                    break;
+            }
+
+            emit triggerFired(trigger, (ChunkRing::timestamp() - timestamp) / 1000);
+        }
+    }
+
+    dump->write(chunk.mid(dumped), timestamp, CaptureReceived);
+}
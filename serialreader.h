@@ -0,0 +1,158 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SerialReader class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef SERIALREADER_H
+#define SERIALREADER_H
+
+#include "triggerengine.h"
+
+#include <QObject>
+
+class QSerialPort;
+class QThread;
+class QTimer;
+class ChunkRing;
+class DumpWriter;
+
+/**
+ * \brief drain a serial port from a dedicated thread
+ *
+ * while reading, the serial port instance lives in the reader thread:
+ * incoming data is moved into a ChunkRing as soon as the port signals it,
+ * whatever the GUI thread is busy with, and dataAvailable() is emitted
+ * to let the consumer pop it on its own schedule.
+ *
+ * when the ring is full, data is left in the QSerialPort internal buffer
+ * (which is unbounded) and the reader retries shortly after, so the kernel
+ * tty buffer is always emptied.
+ *
+ * received data is also written to the dump file and scanned for trigger
+ * patterns from the reader thread, before being pushed into the ring:
+ * trigger actions are performed right away, whatever the GUI thread is
+ * busy with.
+ *
+ * start() and stop() must be called from the thread owning the serial port
+ * instance, stop() gives it back to that thread
+ */
+class SerialReader : public QObject
+{
+    Q_OBJECT
+
+private:
+
+    /// ring buffer receiving the data
+    ChunkRing   *ring;
+
+    /// serial port being read, 0 when stopped
+    QSerialPort *serial;
+
+    /// thread the serial port is given back to when stopped
+    QThread     *home_thread;
+
+    /// retry timer used when the ring is full
+    QTimer      *retry_timer;
+
+    /// dump file writer
+    DumpWriter  *dump;
+
+    /// trigger patterns matcher, only accessed from the reader thread
+    TriggerEngine triggers;
+
+public:
+
+    /**
+     * \brief create a reader
+     * \param ring ring buffer to fill
+     * \param dump dump file writer, received data is written to it
+     * \note the instance must be moved to its own thread before calling start()
+     */
+    SerialReader(ChunkRing *ring, DumpWriter *dump);
+
+    /**
+     * \brief start reading from an opened serial port
+     * \param serial serial port, it is moved to the reader thread
+     */
+    void start(QSerialPort *serial);
+
+    /**
+     * \brief stop reading and move back the serial port to the caller thread
+     * \note blocks until the reader thread has released the port
+     */
+    void stop();
+
+    /**
+     * \brief return true if the reader currently owns a serial port
+     */
+    bool isReading() const;
+
+    /**
+     * \brief write data to the serial port from the reader thread
+     * \param data    byte array data
+     */
+    void write(const QByteArray &data);
+
+    /**
+     * \brief replace the triggers applied to received data
+     * \param new_triggers triggers, see TriggerEngine::parse(), empty for none
+     */
+    void setTriggers(const QVector<TriggerEngine::Trigger> &new_triggers);
+
+private:
+
+    /**
+     * \brief connect serial port signals, in reader thread
+     */
+    Q_INVOKABLE void attachPort();
+
+    /**
+     * \brief disconnect serial port and move it back, in reader thread
+     */
+    Q_INVOKABLE void detachPort();
+
+    /**
+     * \brief write data, in reader thread
+     */
+    Q_INVOKABLE void writeData(const QByteArray &data);
+
+    /**
+     * \brief compile new triggers, in reader thread
+     */
+    Q_INVOKABLE void installTriggers(const QVector<TriggerEngine::Trigger> &new_triggers);
+
+    /**
+     * \brief move as much available data as possible into the ring
+     */
+    void drainPort();
+
+    /**
+     * \brief dump a received chunk and perform the actions it triggers
+     * \param chunk     received data
+     * \param timestamp reception timestamp
+     */
+    void handleChunk(const QByteArray &chunk, qint64 timestamp);
+
+signals:
+
+    /**
+     * \brief signal emitted when chunks have been pushed into an empty
+     *  or already drained ring
+     */
+    void dataAvailable();
+
+    /**
+     * \brief signal emitted after a trigger action has been performed
+     * \param trigger        fired trigger
+     * \param latency_usecs  time from data reception to action completion
+     */
+    void triggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs);
+};
+
+#endif // SERIALREADER_H
@@ -12,12 +12,25 @@
 #include "sessionmanager.h"
 #include "outputmanager.h"
 #include "xmodemtransfer.h"
+#include "ymodemtransfer.h"
+#include "zmodemtransfer.h"
+#include "chunkring.h"
+#include "serialreader.h"
+#include "replaysource.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
 #include <QSerialPortInfo>
 #include <QProgressDialog>
 #include <QMessageBox>
-#include <QFile>
+#include <QThread>
+#include <QTimer>
+
+#include <string.h>
+
+/// maximum amount of data emitted at once by dataReceived
+const int MAX_BATCH_SIZE = 256 * 1024;
 
 SessionManager::SessionManager(QObject *parent) :
     QObject(parent)
@@ -25,14 +38,60 @@ SessionManager::SessionManager(QObject *parent) :
     serial = new QSerialPort();
     in_progress = false;
     file_transfer = 0;
-
-    connect(serial, &QSerialPort::readyRead, this, &SessionManager::readData);
+    transfer_follow_msecs = 0;
+    transfer_window_bytes = 0;
+    replay = 0;
+
+    memset(&trigger_stats, 0, sizeof(trigger_stats));
+    memset(&transfer_stats, 0, sizeof(transfer_stats));
+
+    // errors and fired triggers may be emitted from the reader thread
+    qRegisterMetaType<QSerialPort::SerialPortError>("QSerialPort::SerialPortError");
+    qRegisterMetaType<TriggerEngine::Trigger>("TriggerEngine::Trigger");
+    qRegisterMetaType<QVector<TriggerEngine::Trigger> >("QVector<TriggerEngine::Trigger>");
+
+    // dump file is written from its own thread
+    dump_thread = new QThread(this);
+    dump_writer = new DumpWriter();
+    dump_writer->moveToThread(dump_thread);
+    connect(dump_thread, &QThread::finished, dump_writer, &QObject::deleteLater);
+    dump_thread->start();
+
+    // serial port is read from a dedicated thread too, which fills rx_ring
+    // and feeds the dump writer
+    rx_ring = new ChunkRing();
+    reader_thread = new QThread(this);
+    reader = new SerialReader(rx_ring, dump_writer);
+    reader->moveToThread(reader_thread);
+    connect(reader_thread, &QThread::finished, reader, &QObject::deleteLater);
+    reader_thread->start();
+
+    connect(reader, &SerialReader::dataAvailable, this, &SessionManager::readData);
+    connect(reader, &SerialReader::triggerFired, this, &SessionManager::handleTriggerFired);
     connect(serial, static_cast<void (QSerialPort::*)(QSerialPort::SerialPortError)>
                 (&QSerialPort::error), this, &SessionManager::handleError);
 }
 
 SessionManager::~SessionManager()
 {
+    // replay thread must not outlive the ring buffer
+    if (replay)
+    {
+        replay->stop();
+        replay->wait();
+        delete replay;
+    }
+
+    // get serial port back before ending the reader thread
+    reader->stop();
+    reader_thread->quit();
+    reader_thread->wait();
+    delete rx_ring;
+
+    dump_writer->close();
+    dump_thread->quit();
+    dump_thread->wait();
+
     if (serial)
     {
         // closes connection if needed
@@ -62,6 +121,9 @@ void SessionManager::handleError(QSerialPort::SerialPortError serialPortError)
         default:
             if (in_progress)
             {
+                // error may come from the reader thread, get the port back first
+                reader->stop();
+
                 QMessageBox::critical(NULL, tr("Error"), serial->errorString());
 
                 // on some error (ex: hot unplugging) the 'QSerialPort::error' property successively
@@ -83,6 +145,13 @@ void SessionManager::handleError(QSerialPort::SerialPortError serialPortError)
 
 void SessionManager::openSession(const QHash<QString, QString>& port_cfg)
 {
+    // replay and serial reader can't fill the ring at the same time
+    if (replay)
+    {
+        emit sessionClosed();
+        return;
+    }
+
     bool cfg_ok = true, ok;
 
     // try converting port config from the hash
@@ -142,6 +211,24 @@ void SessionManager::openSession(const QHash<QString, QString>& port_cfg)
     if (serial->open(QIODevice::ReadWrite))
     {
         curr_cfg = port_cfg;
+
+        // open dump file for the whole session
+        if (curr_cfg["dump_enabled"] == "1")
+        {
+            dump_writer->setSyncPolicy(static_cast<DumpWriter::SyncPolicy>
+                    (curr_cfg["dump_sync"].toInt()));
+            if (!dump_writer->open(curr_cfg["dump_file"],
+                    static_cast<ConnectDialog::DumpFormat>(curr_cfg["dump_format"].toInt())))
+            {
+                QMessageBox::warning(NULL, tr("Error"),
+                        tr("Can't open dump file %1").arg(curr_cfg["dump_file"]));
+            }
+        }
+
+        // drop leftovers of previous session and start reading
+        rx_ring->clear();
+        reader->start(serial);
+
         emit sessionOpened();
     }
     else
@@ -155,7 +242,14 @@ void SessionManager::closeSession()
 {
     if (serial->isOpen())
     {
+        reader->stop();
         serial->close();
+
+        // display everything received until now
+        while (!rx_ring->isEmpty())
+            readData();
+        dump_writer->close();
+
         emit sessionClosed();
     }
 }
@@ -165,65 +259,191 @@ bool SessionManager::isSessionOpen() const
     return serial->isOpen();
 }
 
-void SessionManager::saveToFile(const QByteArray &data)
+void SessionManager::saveToFile(const QByteArray &data, qint64 timestamp,
+                                CaptureRecordType type)
+{
+    dump_writer->write(data, timestamp, type);
+}
+
+void SessionManager::startReplay(const QString &filename, double speed)
 {
-    QFile dump(curr_cfg["dump_file"]);
+    Q_ASSERT_X(!serial->isOpen(), "SessionManager::startReplay", "session is open");
+    if (replay || serial->isOpen())
+        return;
 
-    // mode is OR'ed with 'Text' flag in "Ascii" mode
-    QIODevice::OpenMode mode = QIODevice::Append;
+    rx_ring->clear();
 
-    if (curr_cfg["dump_file"] == QString::number(ConnectDialog::Ascii))
-        mode |= QIODevice::Text;
+    replay = new ReplaySource(rx_ring, filename, speed);
+    connect(replay, &ReplaySource::dataAvailable, this, &SessionManager::readData);
+    connect(replay, &ReplaySource::replayEnded, this, &SessionManager::handleReplayEnded);
 
-    if (dump.open(mode))
-        dump.write(data);
+    replay_timer.start();
+    replay->start();
+    emit replayStarted();
+}
+
+void SessionManager::stopReplay()
+{
+    if (replay)
+        replay->stop();
+}
+
+bool SessionManager::isReplaying() const
+{
+    return replay != 0;
+}
+
+void SessionManager::handleReplayEnded(bool ok, qint64 bytes)
+{
+    // push remaining data through the pipeline before measuring
+    while (!rx_ring->isEmpty())
+        readData();
+
+    const qint64 msecs = replay_timer.elapsed();
+
+    // instance has been moved back to this thread, its destructor waits
+    // for the replay thread to return
+    replay->deleteLater();
+    replay = 0;
+
+    emit replayEnded(ok, bytes, msecs);
+}
+
+DumpWriter::Statistics SessionManager::dumpStatistics() const
+{
+    return dump_writer->statistics();
+}
+
+void SessionManager::setTriggers(const QVector<TriggerEngine::Trigger> &triggers)
+{
+    memset(&trigger_stats, 0, sizeof(trigger_stats));
+    reader->setTriggers(triggers);
+}
+
+SessionManager::TriggerStatistics SessionManager::triggerStatistics() const
+{
+    return trigger_stats;
+}
+
+void SessionManager::handleTriggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs)
+{
+    ++trigger_stats.fired;
+    trigger_stats.last_latency_usecs = latency_usecs;
+    trigger_stats.max_latency_usecs = qMax(trigger_stats.max_latency_usecs, latency_usecs);
+    trigger_stats.total_latency_usecs += latency_usecs;
+
+    emit triggerFired(trigger, latency_usecs);
 }
 
 void SessionManager::readData()
 {
-    QByteArray data(serial->readAll());
+    // acknowledge first, chunks pushed from now on will trigger a new call
+    rx_ring->acknowledgeNotify();
 
-    emit dataReceived(data);
+    // received data has already been written to the dump file by the reader
+    QByteArray data, chunk;
+    qint64 timestamp;
+    while (data.size() < MAX_BATCH_SIZE && rx_ring->pop(&chunk, &timestamp))
+        data.append(chunk);
+
+    // let the event loop breathe before handling next batch
+    if (!rx_ring->isEmpty())
+        QTimer::singleShot(0, this, &SessionManager::readData);
 
-    // append to dump file if configured
-    if (curr_cfg["dump_enabled"] == "1")
-        saveToFile(data);
+    if (data.isEmpty())
+        return;
+
+    emit dataReceived(data);
 }
 
 void SessionManager::sendToSerial(const QByteArray &data)
 {
-    serial->write(data);
+    saveToFile(data, ChunkRing::timestamp(), CaptureTransmitted);
+
+    if (reader->isReading())
+        reader->write(data);
+    else
+        serial->write(data);
 }
 
-void SessionManager::transferFile(const QString &filename, Protocol type)
+void SessionManager::transferFile(const QString &filename, Protocol type,
+                                  FileTransfer::Direction direction)
 {
+    if (direction == FileTransfer::Send)
+    {
+        transferFiles(QStringList(filename), type);
+        return;
+    }
+
     switch (type)
     {
         case XMODEM:
-            file_transfer = new XModemTransfer(0, serial, filename);
+            file_transfer = new XModemTransfer(0, serial, filename, direction);
+        break;
+        default:
+            // only XModem receives
+            emit fileTransferEnded(FileTransfer::UnsupportedError);
+            return;
+    }
+
+    startFileTransfer();
+}
+
+void SessionManager::transferFiles(const QStringList &filenames, Protocol type)
+{
+    switch (type)
+    {
+        case XMODEM:
+            Q_ASSERT_X(filenames.size() == 1, "SessionManager::transferFiles",
+                       "XModem sends a single file");
+            file_transfer = new XModemTransfer(0, serial, filenames.value(0));
         break;
         case YMODEM:
+            file_transfer = new YModemTransfer(0, serial, filenames);
+        break;
         case ZMODEM:
-            Q_ASSERT_X(false, "SessionManager::transferFile", "not implemented");
+        {
+            ZModemTransfer *zmodem = new ZModemTransfer(0, serial, filenames);
+            zmodem->setWindow(transfer_window_bytes);
+            file_transfer = zmodem;
+        }
         break;
         default:
+            emit fileTransferEnded(FileTransfer::UnsupportedError);
             return;
     }
 
+    startFileTransfer();
+}
+
+void SessionManager::startFileTransfer()
+{
+    file_transfer->setFollow(transfer_follow_msecs);
+    if (!transfer_stats_dir.isEmpty())
+    {
+        const QString name = QStringLiteral("transfer-%1.csv")
+            .arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss-zzz")));
+        file_transfer->setStatsFile(QDir(transfer_stats_dir).filePath(name));
+    }
+
     connect(file_transfer, &FileTransfer::transferEnded,
             this, &SessionManager::handleFileTransferEnded);
 
     // forward FileTransfer::transferProgressed signals
     connect(file_transfer, &FileTransfer::transferProgressed,
             this, &SessionManager::fileTransferProgressed);
+    connect(file_transfer, &FileTransfer::transferMeasured,
+            this, &SessionManager::fileTransferMeasured);
 
     disconnect(serial, static_cast<void (QSerialPort::*)(QSerialPort::SerialPortError)>
                 (&QSerialPort::error), this, &SessionManager::handleError);
 
-    // perform transfer
-    if (!file_transfer->startTransfer())
-        // transfer never started, manually delete FileTransfer instance
-        delete file_transfer;
+    // the transfer thread takes over the serial port
+    reader->stop();
+
+    // perform transfer, if it can't start handleFileTransferEnded() has
+    // already been called
+    file_transfer->startTransfer();
 }
 
 void SessionManager::handleFileTransferEnded(FileTransfer::TransferError error)
@@ -232,15 +452,44 @@ void SessionManager::handleFileTransferEnded(FileTransfer::TransferError error)
     connect(serial, static_cast<void (QSerialPort::*)(QSerialPort::SerialPortError)>
                 (&QSerialPort::error), this, &SessionManager::handleError);
 
+    // serial port is back in main thread, resume reading
+    if (serial->isOpen())
+        reader->start(serial);
+
+    transfer_stats = file_transfer->statistics();
+
     // schedule file_transfer object deletion on main thread
     QCoreApplication::postEvent(file_transfer, new QEvent(QEvent::DeferredDelete));
+    file_transfer = 0;
     emit fileTransferEnded(error);
 }
 
 
+void SessionManager::setTransferFollow(int idle_msecs)
+{
+    transfer_follow_msecs = idle_msecs;
+}
+
+void SessionManager::setTransferWindow(int bytes)
+{
+    transfer_window_bytes = bytes;
+}
+
+void SessionManager::setTransferStatsDir(const QString &dir)
+{
+    transfer_stats_dir = dir;
+}
+
+FileTransfer::Statistics SessionManager::fileTransferStatistics() const
+{
+    return transfer_stats;
+}
+
 void SessionManager::handleTransferCancelledByUser()
 {
-    Q_ASSERT_X(file_transfer, "SessionManager::handleTransferCancelledByUser",
-               "file_transfer shound not be NULL");
+    // the dialog stays open after the transfer ended, to show its result
+    if (!file_transfer)
+        return;
+
     file_transfer->quit_requested = true;
 }
@@ -14,11 +14,18 @@
 
 #include "connectdialog.h"
 #include "filetransfer.h"
+#include "dumpwriter.h"
+#include "triggerengine.h"
 
 #include <QObject>
 #include <QSerialPort>
+#include <QElapsedTimer>
 
 class FileTransfer;
+class ReplaySource;
+class ChunkRing;
+class SerialReader;
+class QThread;
 
 /**
  * \brief manage serial port session
@@ -39,11 +46,54 @@ public:
         ZMODEM = 100
     };
 
+    /**
+     * \brief trigger counters, latencies are measured from data reception
+     *  to action completion
+     */
+    struct TriggerStatistics
+    {
+        /// number of fired triggers
+        qint64 fired;
+
+        /// latency of the last fired trigger, in microseconds
+        qint64 last_latency_usecs;
+
+        /// longest latency, in microseconds
+        qint64 max_latency_usecs;
+
+        /// cumulated latency, in microseconds
+        qint64 total_latency_usecs;
+    };
+
 private:
 
     /// serial port instance
     QSerialPort            *serial;
 
+    /// ring buffer filled by the reader thread, drained by readData()
+    ChunkRing              *rx_ring;
+
+    /// serial port reader, living in reader_thread
+    SerialReader           *reader;
+
+    /// thread reading the serial port while a session is open
+    QThread                *reader_thread;
+
+    /// dump file writer, living in dump_thread
+    DumpWriter             *dump_writer;
+
+    /// thread writing the dump file
+    QThread                *dump_thread;
+
+    /// dump replay in progress, 0 if none
+    ReplaySource           *replay;
+
+    /// measure replay duration
+    QElapsedTimer           replay_timer;
+
+    /// trigger counters
+    TriggerStatistics       trigger_stats;
+
     /// current session configuration
     QHash<QString, QString> curr_cfg;
 
@@ -53,6 +103,18 @@ private:
     /// file transfer implementation
     FileTransfer *file_transfer;
 
+    /// counters of the last ended file transfer
+    FileTransfer::Statistics transfer_stats;
+
+    /// files to send are followed until they have not grown for this long, 0 to disable
+    int transfer_follow_msecs;
+
+    /// ZModem data sent ahead of the receiver acknowledgements, 0 for no limit
+    int transfer_window_bytes;
+
+    /// directory receiving a statistics file per transfer, empty for none
+    QString transfer_stats_dir;
+
 public:
 
     explicit SessionManager(QObject *parent = 0);
@@ -80,12 +142,83 @@ public:
      */
     void sendToSerial(const QByteArray &data);
 
+    /**
+     * \brief replay a dump file as if its content was received from the port
+     * \param filename  dump file to replay
+     * \param speed     speed factor: 1 for original timing, 0 for as fast as possible
+     * \note no session can be opened during a replay
+     */
+    void startReplay(const QString &filename, double speed);
+
+    /**
+     * \brief stop current replay
+     */
+    void stopReplay();
+
+    /**
+     * \brief return true if a replay is in progress
+     */
+    bool isReplaying() const;
+
+    /**
+     * \brief return dump file writer counters of current or last session
+     */
+    DumpWriter::Statistics dumpStatistics() const;
+
+    /**
+     * \brief replace the triggers applied to received data
+     * \param triggers triggers, see TriggerEngine::parse(), empty for none
+     * \note triggers are applied to the data read from the port, not to replays
+     */
+    void setTriggers(const QVector<TriggerEngine::Trigger> &triggers);
+
+    /**
+     * \brief return trigger counters since last setTriggers() call
+     */
+    TriggerStatistics triggerStatistics() const;
+
     /**
      * \brief init a file transfer thread
-     * \param filename  file to transfer
+     * \param filename  file to transfer, or to write received data to
      * \param type      protocol to use
+     * \param direction send or receive filename
+     * \note fileTransferEnded is emitted with UnsupportedError right away if
+     *  the protocol can't transfer in that direction
+     */
+    void transferFile(const QString &filename, Protocol type,
+                      FileTransfer::Direction direction = FileTransfer::Send);
+
+    /**
+     * \brief init a file transfer thread sending several files in one session
+     * \param filenames files to send, in order
+     * \param type      protocol to use, a batch protocol unless there is
+     *  only one file
+     */
+    void transferFiles(const QStringList &filenames, Protocol type);
+
+    /**
+     * \brief send growing files until they have not grown for a while
+     * \param idle_msecs time without growth ending a file, 0 to disable
+     */
+    void setTransferFollow(int idle_msecs);
+
+    /**
+     * \brief limit the data a ZModem transfer sends ahead of the receiver
+     * \param bytes window size, 0 to stream whole files (default)
      */
-    void transferFile(const QString &filename, Protocol type);
+    void setTransferWindow(int bytes);
+
+    /**
+     * \brief write the statistics of each file transfer to a file of dir,
+     *  named after the transfer start time
+     * \param dir existing directory, empty to disable (default)
+     */
+    void setTransferStatsDir(const QString &dir);
+
+    /**
+     * \brief return counters of the last ended file transfer
+     */
+    FileTransfer::Statistics fileTransferStatistics() const;
 
     /**
      * \brief handle file transfer cancelation signal
@@ -95,26 +228,45 @@ public:
 private:
 
     /**
-     * \brief read data from serial port
+     * \brief pop a batch of data received by the reader thread
      */
     void readData();
 
     /**
-     * \brief save given data to configured dump file
+     * \brief queue given data for the dump file, if dump is enabled
+     * \param data      byte array data
+     * \param timestamp data timestamp, see ChunkRing::timestamp()
+     * \param type      data direction
      */
-    void saveToFile(const QByteArray &data);
+    void saveToFile(const QByteArray &data, qint64 timestamp,
+                    CaptureRecordType type = CaptureReceived);
 
     /**
      * \brief handle serial port error
      */
     void handleError(QSerialPort::SerialPortError serialPortError);
 
+    /**
+     * \brief handle ReplaySource::replayEnded signal
+     */
+    void handleReplayEnded(bool ok, qint64 bytes);
+
+    /**
+     * \brief handle SerialReader::triggerFired signal
+     */
+    void handleTriggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs);
+
     /**
      * \brief handle FileTransfer::transferEnded signal
      * \param error transfer end error code
      */
     void handleFileTransferEnded(FileTransfer::TransferError error);
 
+    /**
+     * \brief hand the serial port to file_transfer and start it
+     */
+    void startFileTransfer();
+
 signals:
 
     /**
@@ -133,6 +285,27 @@ signals:
      */
     void dataReceived(const QByteArray &data);
 
+    /**
+     * \brief signal emitted when a replay has started
+     */
+    void replayStarted();
+
+    /**
+     * \brief signal emitted when a replay has ended, once all replayed data
+     *  has been emitted through dataReceived
+     * \param ok     false if the dump file could not be read
+     * \param bytes  amount of bytes replayed
+     * \param msecs  replay duration, in milliseconds
+     */
+    void replayEnded(bool ok, qint64 bytes, qint64 msecs);
+
+    /**
+     * \brief signal emitted when a trigger action has been performed
+     * \param trigger        fired trigger
+     * \param latency_usecs  time from data reception to action completion
+     */
+    void triggerFired(const TriggerEngine::Trigger &trigger, qint64 latency_usecs);
+
     /**
      * \brief signal emitted when file transfer has ended
      * \param error transfer end error code
@@ -145,6 +318,12 @@ signals:
      * \percent percentage of file transfered
      */
     void fileTransferProgressed(int percent);
+
+    /**
+     * \brief signal emitted a few times per second during a file transfer
+     * \param stats transfer counters so far
+     */
+    void fileTransferMeasured(FileTransfer::Statistics stats);
 };
 
 #endif // SESSIONMANAGER_H
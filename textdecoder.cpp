@@ -0,0 +1,271 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TextDecoder class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "textdecoder.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/// replacement character for invalid sequences
+const ushort REPLACEMENT_CHARACTER = 0xFFFD;
+
+/// unicode code points of CP437 characters 0x80 to 0xFF
+const ushort CP437_HIGH_TABLE[128] =
+{
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+/**
+ * \brief copy the run of ASCII bytes starting at src to dst
+ * \return length of the run
+ */
+static int widenAscii(const uchar *src, const uchar *end, ushort *dst)
+{
+    const uchar *p = src;
+
+#ifdef __SSE2__
+    // 16 bytes at a time, interleaved with zeroes
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        if (_mm_movemask_epi8(chunk))
+            break;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), _mm_unpackhi_epi8(chunk, zero));
+        p += 16;
+        dst += 16;
+    }
+#endif
+
+    // 8 bytes at a time
+    while (end - p >= 8)
+    {
+        quint64 word;
+        memcpy(&word, p, sizeof(word));
+        if (word & Q_UINT64_C(0x8080808080808080))
+            break;
+        for (int i = 0; i < 8; ++i)
+            dst[i] = p[i];
+        p += 8;
+        dst += 8;
+    }
+
+    while (p < end && *p < 0x80)
+        *dst++ = *p++;
+
+    return p - src;
+}
+
+TextDecoder::TextDecoder(Encoding encoding) :
+    _encoding(encoding),
+    code_point(0),
+    remaining(0),
+    lower_bound(0x80),
+    upper_bound(0xBF)
+{
+}
+
+void TextDecoder::setEncoding(Encoding encoding)
+{
+    _encoding = encoding;
+    reset();
+}
+
+TextDecoder::Encoding TextDecoder::encoding() const
+{
+    return _encoding;
+}
+
+void TextDecoder::reset()
+{
+    code_point = 0;
+    remaining = 0;
+}
+
+QString TextDecoder::decode(const QByteArray &data)
+{
+    return decode(data.constData(), data.size());
+}
+
+QString TextDecoder::decode(const char *data, int len)
+{
+    // a chunk never decodes to more UTF-16 units than bytes, plus one
+    // replacement for a sequence left incomplete by the previous chunk
+    QString text(len + 1, Qt::Uninitialized);
+    ushort *dst = reinterpret_cast<ushort *>(text.data());
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+
+    ushort *out;
+    switch (_encoding)
+    {
+    case Latin1:
+        for (int i = 0; i < len; ++i)
+            dst[i] = p[i];
+        out = dst + len;
+        break;
+    case Cp437:
+        out = decodeCp437(p, p + len, dst);
+        break;
+    default:
+        out = decodeUtf8(p, p + len, dst);
+        break;
+    }
+
+    text.truncate(out - dst);
+    return text;
+}
+
+QByteArray TextDecoder::encode(const QString &text) const
+{
+    switch (_encoding)
+    {
+    case Latin1:
+        return text.toLatin1();
+    case Cp437:
+    {
+        QByteArray data;
+        data.reserve(text.size());
+        for (const QChar c : text)
+        {
+            if (c.unicode() < 0x80)
+            {
+                data.append(char(c.unicode()));
+                continue;
+            }
+
+            const ushort *found = std::find(CP437_HIGH_TABLE, CP437_HIGH_TABLE + 128, c.unicode());
+            data.append(found != CP437_HIGH_TABLE + 128 ? char(0x80 + (found - CP437_HIGH_TABLE)) : '?');
+        }
+        return data;
+    }
+    default:
+        return text.toUtf8();
+    }
+}
+
+ushort *TextDecoder::decodeUtf8(const uchar *p, const uchar *end, ushort *dst)
+{
+    while (p < end)
+    {
+        if (remaining == 0)
+        {
+            if (*p < 0x80)
+            {
+                const int run = widenAscii(p, end, dst);
+                p += run;
+                dst += run;
+                continue;
+            }
+
+            // lead byte, bounds of the second byte exclude overlong
+            // encodings, surrogates and code points above U+10FFFF
+            const uchar c = *p++;
+            lower_bound = 0x80;
+            upper_bound = 0xBF;
+            if (c >= 0xC2 && c <= 0xDF)
+            {
+                code_point = c & 0x1F;
+                remaining = 1;
+            }
+            else if (c >= 0xE0 && c <= 0xEF)
+            {
+                code_point = c & 0x0F;
+                remaining = 2;
+                if (c == 0xE0)
+                    lower_bound = 0xA0;
+                else if (c == 0xED)
+                    upper_bound = 0x9F;
+            }
+            else if (c >= 0xF0 && c <= 0xF4)
+            {
+                code_point = c & 0x07;
+                remaining = 3;
+                if (c == 0xF0)
+                    lower_bound = 0x90;
+                else if (c == 0xF4)
+                    upper_bound = 0x8F;
+            }
+            else
+            {
+                *dst++ = REPLACEMENT_CHARACTER;
+            }
+            continue;
+        }
+
+        const uchar c = *p;
+        if (c < lower_bound || c > upper_bound)
+        {
+            // truncated sequence, the offending byte starts a new one
+            *dst++ = REPLACEMENT_CHARACTER;
+            remaining = 0;
+            continue;
+        }
+
+        ++p;
+        code_point = (code_point << 6) | (c & 0x3F);
+        lower_bound = 0x80;
+        upper_bound = 0xBF;
+
+        if (--remaining == 0)
+        {
+            if (code_point >= 0x10000)
+            {
+                *dst++ = 0xD800 + ((code_point - 0x10000) >> 10);
+                *dst++ = 0xDC00 + ((code_point - 0x10000) & 0x3FF);
+            }
+            else
+            {
+                *dst++ = code_point;
+            }
+        }
+    }
+
+    return dst;
+}
+
+ushort *TextDecoder::decodeCp437(const uchar *p, const uchar *end, ushort *dst)
+{
+    while (p < end)
+    {
+        if (*p < 0x80)
+        {
+            const int run = widenAscii(p, end, dst);
+            p += run;
+            dst += run;
+        }
+        else
+        {
+            *dst++ = CP437_HIGH_TABLE[*p++ - 0x80];
+        }
+    }
+
+    return dst;
+}
@@ -0,0 +1,111 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TextDecoder class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef TEXTDECODER_H
+#define TEXTDECODER_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * \brief streaming decoder of received bytes into text
+ *
+ * received data is cut at arbitrary places, so a multi-byte UTF-8 sequence
+ * may span two chunks: the decoder keeps the incomplete sequence and
+ * completes it with the next chunk.
+ *
+ * runs of ASCII bytes, which make most of serial traffic, are detected and
+ * widened 16 bytes at a time. Invalid UTF-8 sequences are replaced by
+ * U+FFFD.
+ */
+class TextDecoder
+{
+public:
+    /**
+     * \brief supported encodings
+     */
+    enum Encoding {
+        Utf8    = 1,
+        Latin1  = 2,
+        Cp437   = 3
+    };
+
+private:
+
+    /// encoding of decoded data
+    Encoding    _encoding;
+
+    /// code point of the UTF-8 sequence being decoded
+    uint        code_point;
+
+    /// continuation bytes missing to complete current sequence
+    int         remaining;
+
+    /// lowest valid value for next continuation byte
+    uchar       lower_bound;
+
+    /// highest valid value for next continuation byte
+    uchar       upper_bound;
+
+public:
+
+    explicit TextDecoder(Encoding encoding = Utf8);
+
+    /**
+     * \brief set the encoding, discarding any incomplete sequence
+     */
+    void setEncoding(Encoding encoding);
+
+    /**
+     * \brief return current encoding
+     */
+    Encoding encoding() const;
+
+    /**
+     * \brief discard any incomplete sequence
+     */
+    void reset();
+
+    /**
+     * \brief decode a chunk of data
+     * \return decoded text, an incomplete trailing sequence is kept for the next call
+     */
+    QString decode(const QByteArray &data);
+
+    /**
+     * \brief decode a chunk of data
+     * \param data  data to decode
+     * \param len   length of data
+     */
+    QString decode(const char *data, int len);
+
+    /**
+     * \brief encode text with current encoding
+     * \note chars missing from the encoding are replaced by '?'
+     */
+    QByteArray encode(const QString &text) const;
+
+private:
+
+    /**
+     * \brief decode UTF-8 data to dst
+     * \return end of decoded text
+     */
+    ushort *decodeUtf8(const uchar *p, const uchar *end, ushort *dst);
+
+    /**
+     * \brief decode CP437 data to dst
+     * \return end of decoded text
+     */
+    ushort *decodeCp437(const uchar *p, const uchar *end, ushort *dst);
+};
+
+#endif // TEXTDECODER_H
@@ -0,0 +1,125 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TransferInput class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "transferinput.h"
+
+#include <QtSerialPort>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+TransferInput::TransferInput(QSerialPort *serial) :
+    serial(serial),
+    pos(0)
+{
+}
+
+int TransferInput::getByte(int timeout_ms)
+{
+    if (pos == buffer.size())
+    {
+        QElapsedTimer timer;
+        timer.start();
+        if (!fill(timer, timeout_ms))
+            return -1;
+    }
+
+    return uchar(buffer.at(pos++));
+}
+
+int TransferInput::read(char *data, int len, int timeout_ms)
+{
+    int done = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    forever
+    {
+        const int count = qMin(len - done, buffer.size() - pos);
+        memcpy(data + done, buffer.constData() + pos, count);
+        pos += count;
+        done += count;
+
+        if (done == len)
+            return done;
+
+        // some bytes arrived, the link is alive
+        if (count > 0)
+            timer.restart();
+
+        if (!fill(timer, timeout_ms))
+            return done;
+    }
+}
+
+void TransferInput::discard(int quiet_ms)
+{
+    clear();
+    if (!serial->isOpen())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    forever
+    {
+        serial->readAll();
+
+        const qint64 remaining = quiet_ms - timer.elapsed();
+        if (remaining <= 0)
+            return;
+
+        // received data starts the quiet period over
+        if (serial->waitForReadyRead(remaining) && serial->bytesAvailable() > 0)
+            timer.restart();
+        else if (serial->error() != QSerialPort::NoError && serial->error() != QSerialPort::TimeoutError)
+            return;
+    }
+}
+
+void TransferInput::clear()
+{
+    buffer.clear();
+    pos = 0;
+}
+
+bool TransferInput::fill(const QElapsedTimer &timer, int timeout_ms)
+{
+    bool expired = false;
+
+    forever
+    {
+        if (!serial->isOpen())
+            return false;
+
+        if (serial->bytesAvailable() > 0)
+        {
+            // drop consumed bytes before appending
+            buffer.remove(0, pos);
+            pos = 0;
+            buffer.append(serial->readAll());
+            return true;
+        }
+
+        if (expired)
+            return false;
+
+        // out of time, still pick up data already waiting in the driver:
+        // nothing else reads the port while a sender streams
+        const qint64 remaining = qMax<qint64>(0, timeout_ms - timer.elapsed());
+        expired = remaining == 0;
+
+        // may wake up without data, e.g. once pending output is written
+        if (!serial->waitForReadyRead(remaining) &&
+                serial->error() != QSerialPort::NoError && serial->error() != QSerialPort::TimeoutError)
+            return false;
+    }
+}
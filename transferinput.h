@@ -0,0 +1,97 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TransferInput class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef TRANSFERINPUT_H
+#define TRANSFERINPUT_H
+
+#include <QByteArray>
+
+class QSerialPort;
+class QElapsedTimer;
+
+/**
+ * \brief buffered, blocking input of file transfer protocols
+ *
+ * everything available on the serial port is pulled at once into a local
+ * buffer, from which protocols read bytes or whole blocks: a packet costs a
+ * few waits and reads, instead of one of each per byte.
+ *
+ * timeouts are deadlines: a wait woken up without data resumes with the
+ * remaining time only.
+ *
+ * \note must be used from the thread the serial port lives in
+ */
+class TransferInput
+{
+private:
+
+    /// port data is read from
+    QSerialPort *serial;
+
+    /// data read from the port
+    QByteArray  buffer;
+
+    /// first byte of buffer not consumed yet
+    int         pos;
+
+    Q_DISABLE_COPY(TransferInput)
+
+public:
+
+    /**
+     * \brief create an input with an empty buffer
+     * \param serial port to read from
+     */
+    explicit TransferInput(QSerialPort *serial);
+
+    /**
+     * \brief read one byte
+     * \param timeout_ms maximum time to wait for it, in milliseconds, 0 to
+     *  only take a byte already received
+     * \return byte read, or -1 on timeout or error
+     */
+    int getByte(int timeout_ms);
+
+    /**
+     * \brief read a block of bytes
+     * \param data       read bytes, set
+     * \param len        amount of bytes to read
+     * \param timeout_ms maximum time to wait for each part of the block, the
+     *                   deadline is pushed back whenever bytes arrive, so
+     *                   that slow links are not mistaken for dead ones
+     * \return amount of bytes read, less than len on timeout or error
+     */
+    int read(char *data, int len, int timeout_ms);
+
+    /**
+     * \brief discard all input, until nothing has been received for a while
+     * \param quiet_ms silence required, in milliseconds
+     */
+    void discard(int quiet_ms);
+
+    /**
+     * \brief forget buffered bytes
+     */
+    void clear();
+
+private:
+
+    /**
+     * \brief wait for data until a deadline, and append all available data
+     *  to the buffer
+     * \param timer      started at the beginning of the wait
+     * \param timeout_ms deadline, relative to timer start
+     * \return false if the deadline has passed without data
+     */
+    bool fill(const QElapsedTimer &timer, int timeout_ms);
+};
+
+#endif // TRANSFERINPUT_H
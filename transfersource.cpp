@@ -0,0 +1,179 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TransferSource class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "transfersource.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <string.h>
+
+/// size of the mapped part of a regular file
+const qint64 MAP_WINDOW_SIZE = 4 * 1024 * 1024;
+
+/// interval between two checks of a followed file size
+const int FOLLOW_POLL_MS = 20;
+
+TransferSource::TransferSource() :
+    mapped(false),
+    pos(0),
+    window(0),
+    window_start(0),
+    window_size(0),
+    follow_msecs(0)
+{
+}
+
+TransferSource::~TransferSource()
+{
+    close();
+}
+
+void TransferSource::setFollow(int idle_msecs)
+{
+    follow_msecs = qMax(0, idle_msecs);
+}
+
+bool TransferSource::open(const QString &filename)
+{
+    close();
+    file.setFileName(filename);
+
+    // files are read by whole blocks, a QIODevice buffer would only add a
+    // copy, and wait for more data than requested on streams
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return false;
+
+    mapped = !file.isSequential();
+    pos = 0;
+    return true;
+}
+
+qint64 TransferSource::size() const
+{
+    return file.isSequential() || follow_msecs > 0 ? -1 : file.size();
+}
+
+int TransferSource::read(char *data, int len)
+{
+    int done = 0;
+    QElapsedTimer idle;
+    idle.start();
+
+    while (done < len)
+    {
+        const int count = readAvailable(data + done, len - done);
+        if (count < 0)
+            return -1;
+
+        if (count > 0)
+        {
+            done += count;
+            idle.restart();
+            continue;
+        }
+
+        // end of file, a followed file may still grow
+        if (follow_msecs == 0 || idle.elapsed() >= follow_msecs)
+            break;
+        QThread::msleep(FOLLOW_POLL_MS);
+    }
+
+    return done;
+}
+
+bool TransferSource::seek(qint64 offset)
+{
+    if (mapped)
+    {
+        // leaving the window, the next read maps the right one
+        const bool in_window = offset >= window_start && offset < window_start + window_size;
+        pos = offset;
+        if (!in_window)
+            unmapWindow();
+        return true;
+    }
+
+    if (!file.isSequential())
+    {
+        if (!file.seek(offset))
+            return false;
+        pos = offset;
+        return true;
+    }
+
+    if (offset < pos)
+        return false;
+
+    char dropped[4096];
+    while (pos < offset)
+    {
+        if (read(dropped, qMin<qint64>(sizeof(dropped), offset - pos)) <= 0)
+            return false;
+    }
+    return true;
+}
+
+void TransferSource::close()
+{
+    unmapWindow();
+    file.close();
+    mapped = false;
+}
+
+int TransferSource::readAvailable(char *data, int len)
+{
+    if (!mapped)
+    {
+        // blocks until len bytes or end of stream
+        const int count = file.read(data, len);
+        if (count > 0)
+            pos += count;
+        return count;
+    }
+
+    if (pos >= window_start + window_size)
+    {
+        // window fully read, map the following part of the file
+        unmapWindow();
+
+        const qint64 file_size = file.size();
+        if (pos >= file_size)
+            return 0;
+
+        window_start = pos;
+        window_size = qMin(MAP_WINDOW_SIZE, file_size - pos);
+        window = file.map(window_start, window_size);
+        if (!window)
+        {
+            // can't be mapped, read it
+            window_size = 0;
+            mapped = false;
+            if (!file.seek(pos))
+                return -1;
+            return readAvailable(data, len);
+        }
+    }
+
+    const int count = qMin<qint64>(len, window_start + window_size - pos);
+    memcpy(data, window + (pos - window_start), count);
+    pos += count;
+    return count;
+}
+
+void TransferSource::unmapWindow()
+{
+    if (window)
+        file.unmap(window);
+    window = 0;
+    window_start = pos;
+    window_size = 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TransferSource class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef TRANSFERSOURCE_H
+#define TRANSFERSOURCE_H
+
+#include <QFile>
+
+/**
+ * \brief block-oriented reader of a file to send
+ *
+ * regular files are read through a sliding memory-mapped window, other
+ * files (FIFOs, character devices) are read as a stream. Either way, memory
+ * use does not depend on the file size and the first block is available as
+ * soon as the file is open.
+ *
+ * when following, reaching the end of the file is not the end of the
+ * source until the file has stopped growing for a while.
+ *
+ * \note opening a FIFO blocks until a writer opens it
+ */
+class TransferSource
+{
+private:
+
+    /// file being read
+    QFile   file;
+
+    /// set if file is read through mapped windows
+    bool    mapped;
+
+    /// offset of next byte to read
+    qint64  pos;
+
+    /// currently mapped part of the file, or null
+    uchar   *window;
+
+    /// file offset of window
+    qint64  window_start;
+
+    /// size of window
+    qint64  window_size;
+
+    /// time without growth ending a followed file, 0 if not following
+    int     follow_msecs;
+
+    Q_DISABLE_COPY(TransferSource)
+
+public:
+
+    TransferSource();
+    ~TransferSource();
+
+    /**
+     * \brief wait for more data at end of file, until the file has not grown
+     *  for a while
+     * \param idle_msecs time without growth ending the source, 0 to stop at
+     *  the first end of file
+     */
+    void setFollow(int idle_msecs);
+
+    /**
+     * \brief open a file
+     * \return false if the file can't be opened
+     */
+    bool open(const QString &filename);
+
+    /**
+     * \brief return the file size, or -1 if unknown: stream or followed file
+     */
+    qint64 size() const;
+
+    /**
+     * \brief read the next block
+     * \param data  read bytes, set
+     * \param len   block size
+     * \return amount of bytes read, less than len at the end of the source,
+     *  or -1 on error
+     */
+    int read(char *data, int len);
+
+    /**
+     * \brief move to given offset, so that the next read starts there
+     * \return false if the file can't be repositioned: streams only move
+     *  forward, by reading and dropping data
+     */
+    bool seek(qint64 offset);
+
+    /**
+     * \brief close the file
+     */
+    void close();
+
+private:
+
+    /**
+     * \brief read bytes available now, without waiting for the file to grow
+     * \return amount of bytes read, 0 at end of file, -1 on error
+     */
+    int readAvailable(char *data, int len);
+
+    /**
+     * \brief unmap current window
+     */
+    void unmapWindow();
+};
+
+#endif // TRANSFERSOURCE_H
@@ -0,0 +1,365 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TriggerEngine class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include "triggerengine.h"
+
+#include <QFile>
+#include <QList>
+
+#include <algorithm>
+
+/// action names, in Action order
+static const char *const ACTION_NAMES[] = { "send", "mark", "startdump", "stopdump" };
+
+/**
+ * \brief return the value of a hex digit, -1 if c is not one
+ */
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * \brief split a definition line into words, unquoting quoted ones
+ * \return false on unterminated string or invalid escape
+ */
+static bool splitWords(const QByteArray &line, QList<QByteArray> *words)
+{
+    int i = 0;
+    forever
+    {
+        while (i < line.size() && (line.at(i) == ' ' || line.at(i) == '\t'))
+            ++i;
+        if (i == line.size())
+            return true;
+
+        QByteArray word;
+        if (line.at(i) != '"')
+        {
+            while (i < line.size() && line.at(i) != ' ' && line.at(i) != '\t')
+                word.append(line.at(i++));
+            words->append(word);
+            continue;
+        }
+
+        // quoted string
+        ++i;
+        forever
+        {
+            if (i == line.size())
+                return false;
+
+            char c = line.at(i++);
+            if (c == '"')
+                break;
+
+            if (c == '\\')
+            {
+                if (i == line.size())
+                    return false;
+
+                c = line.at(i++);
+                switch (c)
+                {
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case '\\':
+                    case '"':
+                        break;
+                    case 'x':
+                    {
+                        // exactly two hex digits, no sign nor spaces
+                        if (i + 2 > line.size())
+                            return false;
+                        const int high = hexDigit(line.at(i));
+                        const int low = hexDigit(line.at(i + 1));
+                        if (high < 0 || low < 0)
+                            return false;
+                        c = char(high << 4 | low);
+                        i += 2;
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+            word.append(c);
+        }
+        words->append(word);
+    }
+}
+
+TriggerEngine::TriggerEngine() :
+    transitions(256, 0),
+    output_start(2, 0),
+    state(0)
+{
+}
+
+bool TriggerEngine::parse(const QByteArray &text, QVector<Trigger> *triggers, QString *error)
+{
+    triggers->clear();
+
+    const QList<QByteArray> lines = text.split('\n');
+    for (int n = 0; n < lines.size(); ++n)
+    {
+        const QByteArray line = lines.at(n).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QList<QByteArray> words;
+        if (!splitWords(line, &words))
+        {
+            *error = QStringLiteral("line %1: unterminated string or invalid escape").arg(n + 1);
+            return false;
+        }
+
+        if (words.size() < 3 || words.size() > 4)
+        {
+            *error = QStringLiteral("line %1: expected <literal|regex> <pattern> <action> [<data>]")
+                        .arg(n + 1);
+            return false;
+        }
+
+        Trigger trigger;
+        if (words.at(0) == "literal" || words.at(0) == "regex")
+        {
+            trigger.regex = words.at(0) == "regex";
+        }
+        else
+        {
+            *error = QStringLiteral("line %1: unknown pattern kind '%2'")
+                        .arg(n + 1).arg(QString::fromUtf8(words.at(0)));
+            return false;
+        }
+
+        trigger.pattern = words.at(1);
+        if (trigger.pattern.isEmpty())
+        {
+            *error = QStringLiteral("line %1: empty pattern").arg(n + 1);
+            return false;
+        }
+
+        if (trigger.regex)
+        {
+            const QRegularExpression regex(QString::fromUtf8(trigger.pattern));
+            if (!regex.isValid())
+            {
+                *error = QStringLiteral("line %1: %2").arg(n + 1).arg(regex.errorString());
+                return false;
+            }
+        }
+
+        const char *const *name = std::find(ACTION_NAMES, ACTION_NAMES + 4, words.at(2));
+        if (name == ACTION_NAMES + 4)
+        {
+            *error = QStringLiteral("line %1: unknown action '%2'")
+                        .arg(n + 1).arg(QString::fromUtf8(words.at(2)));
+            return false;
+        }
+        trigger.action = static_cast<Action>(name - ACTION_NAMES);
+
+        // only send takes data
+        if ((trigger.action == Send) != (words.size() == 4))
+        {
+            *error = QStringLiteral("line %1: send, and only send, takes data to send").arg(n + 1);
+            return false;
+        }
+        trigger.data = words.value(3);
+
+        triggers->append(trigger);
+    }
+
+    return true;
+}
+
+bool TriggerEngine::load(const QString &filename, QVector<Trigger> *triggers, QString *error)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        *error = file.errorString();
+        return false;
+    }
+
+    return parse(file.readAll(), triggers, error);
+}
+
+void TriggerEngine::setTriggers(const QVector<Trigger> &new_triggers)
+{
+    triggers = new_triggers;
+    regexes.clear();
+    regex_triggers.clear();
+
+    // trie of literal patterns, -1 for missing transitions
+    transitions = QVector<qint32>(256, -1);
+    QVector<QVector<int> > state_outputs(1);
+
+    for (int i = 0; i < triggers.size(); ++i)
+    {
+        const Trigger &trigger = triggers.at(i);
+        if (trigger.regex)
+        {
+            regexes.append(QRegularExpression(QString::fromUtf8(trigger.pattern)));
+            regexes.last().optimize();
+            regex_triggers.append(i);
+            continue;
+        }
+
+        qint32 s = 0;
+        for (int k = 0; k < trigger.pattern.size(); ++k)
+        {
+            const int index = s * 256 + uchar(trigger.pattern.at(k));
+            if (transitions.at(index) < 0)
+            {
+                transitions[index] = state_outputs.size();
+                transitions += QVector<qint32>(256, -1);
+                state_outputs.append(QVector<int>());
+            }
+            s = transitions.at(index);
+        }
+        state_outputs[s].append(i);
+    }
+
+    // breadth first, so that the failure state of a state, which is
+    // shallower, is complete when the state is visited: missing transitions
+    // are those of the failure state, outputs include its outputs
+    QVector<qint32> fail(state_outputs.size(), 0);
+    QVector<qint32> queue;
+
+    for (int c = 0; c < 256; ++c)
+    {
+        if (transitions.at(c) < 0)
+            transitions[c] = 0;
+        else
+            queue.append(transitions.at(c));
+    }
+
+    for (int head = 0; head < queue.size(); ++head)
+    {
+        const qint32 s = queue.at(head);
+        state_outputs[s] += state_outputs.at(fail.at(s));
+
+        for (int c = 0; c < 256; ++c)
+        {
+            const qint32 next = transitions.at(s * 256 + c);
+            const qint32 fail_next = transitions.at(fail.at(s) * 256 + c);
+            if (next < 0)
+            {
+                transitions[s * 256 + c] = fail_next;
+            }
+            else
+            {
+                fail[next] = fail_next;
+                queue.append(next);
+            }
+        }
+    }
+
+    // flatten outputs, ordered by trigger index
+    output_start.clear();
+    outputs.clear();
+    for (int s = 0; s < state_outputs.size(); ++s)
+    {
+        QVector<int> &state_triggers = state_outputs[s];
+        std::sort(state_triggers.begin(), state_triggers.end());
+
+        output_start.append(outputs.size());
+        outputs += state_triggers;
+    }
+    output_start.append(outputs.size());
+
+    reset();
+}
+
+const TriggerEngine::Trigger& TriggerEngine::trigger(int index) const
+{
+    return triggers.at(index);
+}
+
+bool TriggerEngine::isEmpty() const
+{
+    return triggers.isEmpty();
+}
+
+void TriggerEngine::reset()
+{
+    state = 0;
+    line.clear();
+}
+
+void TriggerEngine::scan(const char *data, int len, QVector<Match> *matches)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const qint32 *table = transitions.constData();
+    const int *starts = output_start.constData();
+    const bool match_lines = !regexes.isEmpty();
+
+    int line_start = 0;
+    qint32 s = state;
+
+    for (int i = 0; i < len; ++i)
+    {
+        s = table[s * 256 + p[i]];
+
+        if (starts[s] != starts[s + 1])
+        {
+            for (int k = starts[s]; k < starts[s + 1]; ++k)
+            {
+                const Match match = { outputs.at(k), i + 1 };
+                matches->append(match);
+            }
+        }
+
+        if (match_lines && p[i] == '\n')
+        {
+            line.append(data + line_start, qMin(i - line_start, MAX_LINE_LENGTH - line.size()));
+            matchLine(i + 1, matches);
+            line_start = i + 1;
+        }
+    }
+
+    if (match_lines)
+        line.append(data + line_start, qMin(len - line_start, MAX_LINE_LENGTH - line.size()));
+
+    state = s;
+}
+
+void TriggerEngine::matchLine(int end, QVector<Match> *matches)
+{
+    if (line.endsWith('\r'))
+        line.chop(1);
+
+    const QString text = QString::fromUtf8(line);
+    for (int r = 0; r < regexes.size(); ++r)
+    {
+        if (regexes.at(r).match(text).hasMatch())
+        {
+            const Match match = { regex_triggers.at(r), end };
+            matches->append(match);
+        }
+    }
+
+    line.clear();
+}
@@ -0,0 +1,178 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief TriggerEngine class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef TRIGGERENGINE_H
+#define TRIGGERENGINE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QRegularExpression>
+#include <QMetaType>
+
+/**
+ * \brief find user patterns in the received stream, chunk after chunk
+ *
+ * all literal patterns are compiled into a single Aho-Corasick automaton,
+ * stored as a full transition table: each received byte costs one table
+ * lookup whatever the number of patterns, and occurences spanning two
+ * chunks are found since the automaton state is kept between chunks.
+ *
+ * regex patterns are matched against each complete line (LF terminated,
+ * trailing CR removed, decoded as UTF-8), lines longer than MAX_LINE_LENGTH
+ * are cut. Matching runs on the thread reading the port: each received line
+ * delays reading by one match of every regex over at most MAX_LINE_LENGTH
+ * bytes, and a pattern with catastrophic backtracking makes that delay grow
+ * much faster than the line length.
+ *
+ * the engine only reports matches, actions are performed by its user.
+ */
+class TriggerEngine
+{
+public:
+
+    /**
+     * \brief action performed when a trigger fires
+     */
+    enum Action
+    {
+        Send        = 0,    /// send bytes to the serial port
+        Mark        = 1,    /// notify the user
+        StartDump   = 2,    /// resume writing the dump file
+        StopDump    = 3     /// suspend writing the dump file
+    };
+
+    /**
+     * \brief a pattern and the action it triggers
+     */
+    struct Trigger
+    {
+        /// literal bytes, or UTF-8 regex
+        QByteArray  pattern;
+
+        /// pattern is a regex
+        bool        regex;
+
+        /// action to perform
+        Action      action;
+
+        /// bytes to send, Send action only
+        QByteArray  data;
+    };
+
+    /**
+     * \brief occurence of a trigger pattern
+     */
+    struct Match
+    {
+        /// index of the trigger
+        int trigger;
+
+        /// offset following the occurence in scanned chunk, or following
+        /// the line end for regex triggers
+        int end;
+    };
+
+    /// maximum length of a line matched against regex patterns
+    static const int MAX_LINE_LENGTH = 4096;
+
+private:
+
+    /// triggers, in definition order
+    QVector<Trigger>            triggers;
+
+    /// automaton transitions, 256 entries per state, state 0 is the root
+    QVector<qint32>             transitions;
+
+    /// for each state, index of its first trigger in outputs, plus a final entry
+    QVector<int>                output_start;
+
+    /// triggers matching at each state, including those of its suffixes
+    QVector<int>                outputs;
+
+    /// current automaton state
+    qint32                      state;
+
+    /// compiled regex patterns
+    QVector<QRegularExpression> regexes;
+
+    /// trigger index of each regex
+    QVector<int>                regex_triggers;
+
+    /// current incomplete line, for regex patterns
+    QByteArray                  line;
+
+public:
+
+    TriggerEngine();
+
+    /**
+     * \brief parse a trigger definition file
+     *
+     * one trigger per line, empty lines and lines starting with '#' ignored:
+     *
+     *     literal|regex <pattern> send|mark|startdump|stopdump [<data>]
+     *
+     * pattern and data are either bare words or double-quoted strings
+     * accepting \\r, \\n, \\t, \\\\, \\" and \\xHH escapes
+     *
+     * \param text      file content
+     * \param triggers  parsed triggers, set
+     * \param error     error description, set on failure
+     * \return false on syntax error or invalid regex
+     */
+    static bool parse(const QByteArray &text, QVector<Trigger> *triggers, QString *error);
+
+    /**
+     * \brief read and parse a trigger definition file, see parse()
+     */
+    static bool load(const QString &filename, QVector<Trigger> *triggers, QString *error);
+
+    /**
+     * \brief compile a set of triggers, replacing current ones
+     * \note triggers are supposed to be valid, see parse()
+     */
+    void setTriggers(const QVector<Trigger> &new_triggers);
+
+    /**
+     * \brief return the trigger at given index
+     */
+    const Trigger& trigger(int index) const;
+
+    /**
+     * \brief return true if no trigger is defined
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief forget partial occurences, the stream starts over
+     */
+    void reset();
+
+    /**
+     * \brief scan next chunk of the stream
+     * \param data     chunk data
+     * \param len      chunk length
+     * \param matches  occurences are appended here, ordered by end offset
+     */
+    void scan(const char *data, int len, QVector<Match> *matches);
+
+private:
+
+    /**
+     * \brief match the current line against regex patterns
+     * \param end  offset following the line end in scanned chunk
+     */
+    void matchLine(int end, QVector<Match> *matches);
+};
+
+Q_DECLARE_METATYPE(TriggerEngine::Trigger)
+
+#endif // TRIGGERENGINE_H
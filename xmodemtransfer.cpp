@@ -14,94 +14,159 @@
 #include "xmodemtransfer.h"
 #include "xmodem.h"
 
-/**
- * \brief g_serial global variable representing the serial port currently
- *                 opened this is needed for _inbyte and _outbyte, functions
- *                 required by the xmodem library
- */
-QSerialPort *g_serial = 0;
-XModemTransfer *_g_transfer = 0;
-
-/**
- * \brief global variable representing the total size of file transferred
- */
-qint64 _total_bytes = 0;
+/// xmodem padding char
+const char XMODEM_CTRLZ = 0x1A;
+
+XModemTransfer::XModemTransfer(QObject *parent, QSerialPort *serial, const QString &filename,
+                               Direction direction)
+    : FileTransfer(parent, serial, filename, direction),
+      block_offset(0),
+      block_len(0),
+      next_offset(0)
+{
+    quit_requested = false;
+}
 
-/**
- * \brief global variable used to represent the amount of bytes already
- * transferred
- */
-qint64 _byte_sent = 0;
+int XModemTransfer::inByte(void *context, unsigned short timeout)
+{
+    // blocking
+    return static_cast<XModemTransfer *>(context)->input.getByte(timeout);
+}
 
-/**
- * \brief global variable representing the last transfer percentage emitted
- */
-int _last_progress = 0;
+int XModemTransfer::inBuffer(void *context, unsigned char *buf, int len, unsigned short timeout)
+{
+    return static_cast<XModemTransfer *>(context)->input.read(reinterpret_cast<char *>(buf), len, timeout);
+}
 
-/**
- * \brief _inbyte consume 1 byte from serial port
- * \param timeout timeout in miliseconds
- * \return consumed byte or -1 in case of error
- */
-int _inbyte(unsigned short timeout)
+void XModemTransfer::inFlush(void *context, unsigned short quiet)
 {
-    char c = 0;
+    static_cast<XModemTransfer *>(context)->input.discard(quiet);
+}
 
-    if (g_serial->isOpen())
+void XModemTransfer::outBuffer(void *context, const unsigned char *buf, int len)
+{
+    QSerialPort *serial = static_cast<XModemTransfer *>(context)->serial;
+    if (serial->isOpen())
     {
-        // blocking
-        if (g_serial->waitForReadyRead(timeout))
-            if (g_serial->getChar(&c))
-                return c;
+        serial->write(reinterpret_cast<const char *>(buf), len);
+
+        // hand the packet to the driver now, the receiver can't answer before
+        serial->flush();
     }
-    return -1;
 }
 
-/**
- * \brief _outbyte write 1 byte to the serial port
- * \param c byte to write
- */
-void _outbyte(int c)
+void XModemTransfer::progress(void *context, int len)
 {
-    QByteArray data(1, (char)c);
-    if (g_serial->isOpen())
-    {
-        g_serial->write(data);
-        ++_byte_sent;
+    XModemTransfer *transfer = static_cast<XModemTransfer *>(context);
+    transfer->stats.bytes = transfer->total_size < 0 ? len : qMin<qint64>(len, transfer->total_size);
+    transfer->reportProgress(transfer->stats.bytes);
+}
 
-        // update progress
-        int cur_progress = 100 * _byte_sent / _total_bytes;
-        if (cur_progress > _last_progress)
-        {
-            // emit transferProgressed if we progressed of at least 1%
-            _last_progress = cur_progress;
-            emit _g_transfer->transferProgressed(cur_progress);
-        }
-    }
+int XModemTransfer::deliver(void *context, const unsigned char *buf, int len)
+{
+    XModemTransfer *transfer = static_cast<XModemTransfer *>(context);
+
+    // the previous packet was not the last one, it has no padding
+    QByteArray &last = transfer->last_packet;
+    if (!last.isEmpty() && !transfer->writeOutput(last.constData(), last.size()))
+        return 1;
+
+    last = QByteArray(reinterpret_cast<const char *>(buf), len);
+
+    transfer->block_offset = transfer->next_offset;
+    transfer->block_len = len;
+    transfer->next_offset += len;
+    transfer->blockReceived(transfer->block_offset, len, BlockReceived);
+    return 0;
 }
 
-XModemTransfer::XModemTransfer(QObject *parent, QSerialPort *serial, const QString &filename)
-    : FileTransfer(parent, serial, filename)
+int XModemTransfer::fetch(void *context, unsigned char *buf, int len)
 {
-    quit_requested = false;
-    _byte_sent = 0;
-    _last_progress = 0;
-    _g_transfer = this;
+    XModemTransfer *transfer = static_cast<XModemTransfer *>(context);
+    const int count = transfer->source.read(reinterpret_cast<char *>(buf), len);
+
+    // measured once written, see protocolEvent()
+    transfer->block_offset = transfer->next_offset;
+    transfer->block_len = qMax(count, 0);
+    transfer->next_offset += transfer->block_len;
+    return count;
+}
+
+void XModemTransfer::protocolEvent(void *context, int event)
+{
+    XModemTransfer *transfer = static_cast<XModemTransfer *>(context);
+    switch (event)
+    {
+        case XMODEM_EVENT_RETRY:
+            ++transfer->stats.retries;
+
+            // when receiving, a packet has been rejected
+            if (transfer->direction == Receive)
+                transfer->blockReceived(transfer->next_offset, 0, BlockRejected);
+            break;
+        case XMODEM_EVENT_DUPLICATE:
+            ++transfer->stats.duplicates;
+            transfer->blockReceived(transfer->block_offset, transfer->block_len, BlockDuplicate);
+            break;
+        case XMODEM_EVENT_SENT:
+            transfer->blockSent(transfer->block_offset, transfer->block_len);
+            break;
+        case XMODEM_EVENT_ACK:
+            transfer->blockReplied(BlockAcked);
+            break;
+        case XMODEM_EVENT_NAK:
+            transfer->blockReplied(BlockRejected);
+            break;
+        case XMODEM_EVENT_CANCEL:
+            transfer->blockReplied(BlockCancelled);
+            break;
+        case XMODEM_EVENT_TIMEOUT:
+            transfer->blockReplied(BlockTimedOut);
+            break;
+        default:
+            break;
+    }
 }
 
 void XModemTransfer::performTransfer()
 {
-    // set global QSerialPort pointer used by _inbyte/_outbyte
-    g_serial = serial;
-    _total_bytes = this->total_size;
+    // I/O callbacks, all of them working on this instance
+    const XModemIO io = { this, &inByte, &inBuffer, &inFlush, &outBuffer, &progress,
+                          &deliver, &protocolEvent, &fetch };
 
     TransferError ret;
 
-    // call xmodem transmission routine
-    int errcode = xmodemTransmit((unsigned char*)buffer.data(), buffer.size(), &quit_requested);
+    int errcode;
+    if (direction == Receive)
+    {
+        // call xmodem reception routine
+        errcode = xmodemReceive(&io, &quit_requested);
+
+        // write last packet, without its padding
+        if (errcode >= 0)
+        {
+            int len = last_packet.size();
+            while (len > 0 && last_packet.at(len - 1) == XMODEM_CTRLZ)
+                --len;
+            if (!writeOutput(last_packet.constData(), len) || !flushOutput())
+                errcode = -7;
+        }
+        else
+        {
+            flushOutput();
+        }
+    }
+    else
+    {
+        // call xmodem transmission routine
+        errcode = xmodemTransmit(&io, &quit_requested);
+    }
 
     switch (errcode)
     {
+        case -7:
+            ret = direction == Receive ? OutputFileError : InputFileError;
+            break;
         case -6:
             ret = LocalCancelledError;
             break;
@@ -109,6 +174,7 @@ void XModemTransfer::performTransfer()
             ret = UnknownError;
             break;
         case -4:
+        case -3:
             ret = TransmissionError;
             break;
         case -2:
@@ -127,6 +193,6 @@ void XModemTransfer::performTransfer()
             break;
     }
 
-    emit transferEnded(ret);
+    finishTransfer(ret);
 }
 
@@ -16,20 +16,43 @@
 
 /**
  * \brief xmodem protocol implementation of FileTransfer
+ *
+ * all transfer state is held by the instance, and handed to the xmodem
+ * library through its I/O callbacks: several transfers may run
+ * concurrently, on different serial ports.
+ *
+ * received packets are streamed to the output file, the last one being held
+ * back until the end of the transfer so that its CTRL-Z padding is removed.
+ * As with any XModem receiver, a file really ending with CTRL-Z chars loses
+ * them.
  */
 class XModemTransfer : public FileTransfer
 {
     Q_OBJECT
 
+private:
+
+    /// last received packet, not written yet
+    QByteArray last_packet;
+
+    /// offset and file bytes of the packet being sent, or last received
+    qint64 block_offset;
+    int    block_len;
+
+    /// offset of the next packet to send or receive
+    qint64 next_offset;
+
 public:
 
     /**
      * \brief create a XModem transfer thread
-     * \param parent   object taking ownership
-     * \param serial   opened instance of QSerialPort
-     * \param filename file to transfer
+     * \param parent    object taking ownership
+     * \param serial    opened instance of QSerialPort
+     * \param filename  file to transfer, or to write received data to
+     * \param direction send or receive filename
      */
-    XModemTransfer(QObject *parent, QSerialPort *serial, const QString &filename);
+    XModemTransfer(QObject *parent, QSerialPort *serial, const QString &filename,
+                   Direction direction = Send);
 
 private:
 
@@ -38,6 +61,74 @@ private:
      * \return transfer end code
      */
     void performTransfer();
+
+    /**
+     * \brief consume 1 byte from serial port, xmodem library callback
+     * \param context   transfer instance
+     * \param timeout   timeout in miliseconds
+     * \return consumed byte or -1 in case of error
+     */
+    static int inByte(void *context, unsigned short timeout);
+
+    /**
+     * \brief consume a block of bytes from serial port, xmodem library callback
+     * \param context   transfer instance
+     * \param buf       consumed bytes
+     * \param len       amount of bytes to consume
+     * \param timeout   maximum time without receiving anything, in miliseconds
+     * \return amount of bytes consumed, less than len on timeout or error
+     */
+    static int inBuffer(void *context, unsigned char *buf, int len, unsigned short timeout);
+
+    /**
+     * \brief discard input until the line has been quiet for a while,
+     *  xmodem library callback
+     * \param context   transfer instance
+     * \param quiet     silence required, in miliseconds
+     */
+    static void inFlush(void *context, unsigned short quiet);
+
+    /**
+     * \brief write a whole packet to the serial port in a single write,
+     *  xmodem library callback
+     * \param context   transfer instance
+     * \param buf       packet to write
+     * \param len       packet length
+     */
+    static void outBuffer(void *context, const unsigned char *buf, int len);
+
+    /**
+     * \brief account a block acknowledged by the receiver, xmodem library callback
+     * \param context   transfer instance
+     * \param len       amount of bytes acknowledged so far, last block padding included
+     */
+    static void progress(void *context, int len);
+
+    /**
+     * \brief write a received packet, xmodem library callback
+     * \param context   transfer instance
+     * \param buf       packet data
+     * \param len       packet length, padding included
+     * \return non zero on write error
+     */
+    static int deliver(void *context, const unsigned char *buf, int len);
+
+    /**
+     * \brief account a protocol event, xmodem library callback
+     * \param context   transfer instance
+     * \param event     see XModemEvent
+     */
+    static void protocolEvent(void *context, int event);
+
+    /**
+     * \brief read the next packet of data to send, xmodem library callback
+     * \param context   transfer instance
+     * \param buf       read data
+     * \param len       packet size
+     * \return amount of bytes read, less than len at the end of the file,
+     *  -1 on error
+     */
+    static int fetch(void *context, unsigned char *buf, int len);
 };
 
 #endif // XMODEMTRANSFER_H
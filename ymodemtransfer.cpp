@@ -0,0 +1,320 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief YModemTransfer class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include <QtSerialPort>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include "ymodemtransfer.h"
+#include "crc16.h"
+
+#include <string.h>
+
+/// ymodem control chars
+const char YMODEM_SOH = 0x01;
+const char YMODEM_STX = 0x02;
+const char YMODEM_EOT = 0x04;
+const char YMODEM_ACK = 0x06;
+const char YMODEM_NAK = 0x15;
+const char YMODEM_CAN = 0x18;
+const char YMODEM_CTRLZ = 0x1A;
+
+/// receiver requests: YMODEM with CRC, YMODEM-G
+const char YMODEM_CRC = 'C';
+const char YMODEM_STREAM = 'G';
+
+/// block sizes, the short one is used for headers and small last blocks
+const int SHORT_BLOCK_SIZE = 128;
+const int BLOCK_SIZE = 1024;
+
+/// time given to the receiver to start
+const int SYNC_TIMEOUT_MS = 60000;
+
+/// time to wait for an acknowledgement
+const int ACK_TIMEOUT_MS = 10000;
+
+/// interval between checks of quit_requested while waiting
+const int POLL_MS = 1000;
+
+/// attempts to send a packet
+const int MAX_RETRIES = 10;
+
+/// bytes streamed ahead of the port, bounds memory use in YMODEM-G
+const qint64 STREAM_WINDOW = 8 * BLOCK_SIZE;
+
+YModemTransfer::YModemTransfer(QObject *parent, QSerialPort *serial, const QStringList &filenames)
+    : FileTransfer(parent, serial, filenames.value(0), Send),
+      filenames(filenames),
+      streaming(false)
+{
+    quit_requested = false;
+}
+
+void YModemTransfer::performTransfer()
+{
+    finishTransfer(sendBatch(filenames));
+}
+
+FileTransfer::TransferError YModemTransfer::beginBatch()
+{
+    return waitStart();
+}
+
+FileTransfer::TransferError YModemTransfer::sendBatchFile(const QString &name)
+{
+    TransferError error = sendHeader(name);
+    if (error == NoError)
+        error = sendData();
+    if (error == NoError)
+        error = waitStart();
+    return error;
+}
+
+FileTransfer::TransferError YModemTransfer::endBatch()
+{
+    return sendHeader(QString());
+}
+
+FileTransfer::TransferError YModemTransfer::waitStart()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < SYNC_TIMEOUT_MS)
+    {
+        if (quit_requested)
+        {
+            cancel();
+            return LocalCancelledError;
+        }
+
+        switch (input.getByte(POLL_MS))
+        {
+            case YMODEM_CRC:
+                streaming = false;
+                return NoError;
+            case YMODEM_STREAM:
+                streaming = true;
+                return NoError;
+            case YMODEM_CAN:
+                if (input.getByte(POLL_MS) == YMODEM_CAN)
+                    return RemoteCancelledError;
+                break;
+            default:
+                // nothing yet, line noise or checksum request
+                break;
+        }
+    }
+
+    cancel();
+    return NoSyncError;
+}
+
+FileTransfer::TransferError YModemTransfer::sendHeader(const QString &name)
+{
+    // name, then size and octal modification time when known
+    QByteArray header;
+    if (!name.isEmpty())
+    {
+        const QFileInfo info(name);
+        QByteArray attributes;
+        if (total_size >= 0)
+        {
+            attributes.append(QByteArray::number(total_size));
+            attributes.append(' ');
+            attributes.append(QByteArray::number(info.lastModified().toMSecsSinceEpoch() / 1000, 8));
+        }
+
+        // a long name is cut so that both NULs fit, at a UTF-8 sequence start
+        header = info.fileName().toUtf8();
+        int len = qMin(header.size(), BLOCK_SIZE - 2 - attributes.size());
+        if (len < header.size())
+        {
+            while (len > 0 && (header.at(len) & 0xC0) == 0x80)
+                --len;
+            header.truncate(len);
+        }
+        header.append('\0');
+        header.append(attributes);
+    }
+
+    // always NUL terminated
+    const int size = header.size() < SHORT_BLOCK_SIZE ? SHORT_BLOCK_SIZE : BLOCK_SIZE;
+    header.append(QByteArray(size - header.size(), '\0'));
+
+    const TransferError error = sendPacket(makePacket(0, header.constData(), size));
+
+    // after the empty header, the batch is over
+    if (error != NoError || name.isEmpty())
+        return error;
+
+    return waitStart();
+}
+
+FileTransfer::TransferError YModemTransfer::sendData()
+{
+    char block[BLOCK_SIZE];
+    unsigned char number = 1;
+    qint64 sent = 0;
+
+    forever
+    {
+        const int len = source.read(block, BLOCK_SIZE);
+        if (len < 0)
+        {
+            cancel();
+            return InputFileError;
+        }
+        if (len == 0)
+            break;
+
+        // last block is padded, to a short block if it fits
+        const int size = len <= SHORT_BLOCK_SIZE ? SHORT_BLOCK_SIZE : BLOCK_SIZE;
+        memset(block + len, YMODEM_CTRLZ, size - len);
+
+        const QByteArray packet = makePacket(number++, block, size);
+        const TransferError error = streaming ? streamPacket(packet, sent, len) : sendPacket(packet, sent, len);
+        if (error != NoError)
+            return error;
+
+        sent += len;
+        stats.bytes += len;
+        reportProgress(sent);
+
+        if (len < BLOCK_SIZE)
+            break;
+    }
+
+    if (streaming && !drainOutput(0))
+    {
+        cancel();
+        return TimeoutError;
+    }
+
+    // receivers usually answer the first EOT with a NAK
+    for (int retry = 0; retry < MAX_RETRIES; ++retry)
+    {
+        serial->write(&YMODEM_EOT, 1);
+        serial->flush();
+
+        switch (input.getByte(ACK_TIMEOUT_MS))
+        {
+            case YMODEM_ACK:
+                return NoError;
+            case YMODEM_CAN:
+                if (input.getByte(POLL_MS) == YMODEM_CAN)
+                    return RemoteCancelledError;
+                break;
+            default:
+                break;
+        }
+    }
+
+    cancel();
+    return TransmissionError;
+}
+
+FileTransfer::TransferError YModemTransfer::sendPacket(const QByteArray &packet, qint64 offset, int len)
+{
+    for (int retry = 0; retry < MAX_RETRIES; ++retry)
+    {
+        if (quit_requested)
+        {
+            cancel();
+            return LocalCancelledError;
+        }
+
+        if (retry > 0)
+            ++stats.retries;
+
+        serial->write(packet);
+        serial->flush();
+        if (offset >= 0)
+            blockSent(offset, len);
+
+        const int c = input.getByte(ACK_TIMEOUT_MS);
+        switch (c)
+        {
+            case YMODEM_ACK:
+                blockReplied(BlockAcked);
+                return NoError;
+            case YMODEM_CAN:
+                blockReplied(BlockCancelled);
+                if (input.getByte(POLL_MS) == YMODEM_CAN)
+                    return RemoteCancelledError;
+                break;
+            default:
+                // NAK or timeout, the rest of the answer is stale
+                blockReplied(c < 0 ? BlockTimedOut : BlockRejected);
+                input.discard(POLL_MS / 10);
+                break;
+        }
+    }
+
+    cancel();
+    return TransmissionError;
+}
+
+FileTransfer::TransferError YModemTransfer::streamPacket(const QByteArray &packet, qint64 offset, int len)
+{
+    if (quit_requested)
+    {
+        cancel();
+        return LocalCancelledError;
+    }
+
+    serial->write(packet);
+    serial->flush();
+    blockSent(offset, len, false);
+
+    if (!drainOutput(STREAM_WINDOW))
+    {
+        cancel();
+        return TimeoutError;
+    }
+
+    // a YMODEM-G receiver only talks to give up
+    int c;
+    while ((c = input.getByte(0)) >= 0)
+    {
+        if (c == YMODEM_CAN)
+        {
+            blockReplied(BlockCancelled);
+            return RemoteCancelledError;
+        }
+    }
+
+    return NoError;
+}
+
+QByteArray YModemTransfer::makePacket(unsigned char number, const char *data, int size)
+{
+    const unsigned short crc = crc16_ccitt(data, size);
+
+    QByteArray packet;
+    packet.reserve(size + 5);
+    packet.append(size == SHORT_BLOCK_SIZE ? YMODEM_SOH : YMODEM_STX);
+    packet.append(char(number));
+    packet.append(char(~number));
+    packet.append(data, size);
+    packet.append(char(crc >> 8));
+    packet.append(char(crc & 0xFF));
+    return packet;
+}
+
+void YModemTransfer::cancel()
+{
+    if (serial->isOpen())
+    {
+        serial->write(QByteArray(3, YMODEM_CAN));
+        serial->flush();
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief YModemTransfer class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef YMODEMTRANSFER_H
+#define YMODEMTRANSFER_H
+
+#include <QStringList>
+
+#include "filetransfer.h"
+
+/**
+ * \brief send a batch of files over YMODEM
+ *
+ * each file is announced by a block 0 header holding its name, size and
+ * modification time, then sent in 1K blocks. Once all files are sent, an
+ * empty header ends the batch.
+ *
+ * the receiver chooses the variant: 'C' asks for YMODEM, where each block
+ * is acknowledged, 'G' asks for YMODEM-G, where blocks are streamed without
+ * acknowledgement and any error cancels the whole batch.
+ */
+class YModemTransfer : public FileTransfer
+{
+    Q_OBJECT
+
+private:
+
+    /// files to send, in order
+    QStringList filenames;
+
+    /// set if the receiver asked for YMODEM-G
+    bool        streaming;
+
+public:
+
+    /**
+     * \brief create a YModem transfer thread
+     * \param parent    object taking ownership
+     * \param serial    opened instance of QSerialPort
+     * \param filenames files to send, at least one
+     */
+    YModemTransfer(QObject *parent, QSerialPort *serial, const QStringList &filenames);
+
+private:
+
+    /**
+     * \brief send the batch, the first file is already open
+     */
+    void performTransfer();
+
+    /**
+     * \brief wait for the receiver to ask for the first header
+     */
+    TransferError beginBatch();
+
+    /**
+     * \brief send the header and the content of a file, then wait for the
+     *  receiver to ask for the next header
+     * \param name file name
+     */
+    TransferError sendBatchFile(const QString &name);
+
+    /**
+     * \brief send the empty header ending the batch
+     */
+    TransferError endBatch();
+
+    /**
+     * \brief wait for the receiver to ask for a header or data, and record
+     *  the requested variant
+     */
+    TransferError waitStart();
+
+    /**
+     * \brief send the block 0 header of the file in source, then wait for
+     *  the receiver to ask for data
+     * \param name file name, empty to end the batch
+     */
+    TransferError sendHeader(const QString &name);
+
+    /**
+     * \brief send the content of source, then end the file
+     */
+    TransferError sendData();
+
+    /**
+     * \brief send a packet until the receiver acknowledges it
+     * \param packet packet to send
+     * \param offset offset of packet data in the file, -1 for a header,
+     *  which is not measured
+     * \param len    file bytes in the packet
+     */
+    TransferError sendPacket(const QByteArray &packet, qint64 offset = -1, int len = 0);
+
+    /**
+     * \brief send a packet without waiting for an acknowledgement, YMODEM-G
+     * \param packet packet to send
+     * \param offset offset of packet data in the file
+     * \param len    file bytes in the packet
+     */
+    TransferError streamPacket(const QByteArray &packet, qint64 offset, int len);
+
+    /**
+     * \brief build a packet: header, block number, data and CRC
+     * \param number    block number
+     * \param data      block data
+     * \param size      block size, 128 or 1024 bytes
+     */
+    static QByteArray makePacket(unsigned char number, const char *data, int size);
+
+    /**
+     * \brief abort the transfer on the receiver side
+     */
+    void cancel();
+};
+
+#endif // YMODEMTRANSFER_H
@@ -0,0 +1,815 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ZModemTransfer class implementation
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#include <QtSerialPort>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include "zmodemtransfer.h"
+#include "crc16.h"
+#include "crc32.h"
+
+#include <string.h>
+
+/// frame delimiters and encodings
+const char ZPAD = '*';
+const char ZDLE = 0x18;
+const char ZBIN = 'A';
+const char ZHEX = 'B';
+const char ZBIN32 = 'C';
+const char XON = 0x11;
+
+/// header types
+const int ZRQINIT = 0;
+const int ZRINIT = 1;
+const int ZACK = 3;
+const int ZFILE = 4;
+const int ZSKIP = 5;
+const int ZNAK = 6;
+const int ZABORT = 7;
+const int ZFIN = 8;
+const int ZRPOS = 9;
+const int ZDATA = 10;
+const int ZEOF = 11;
+const int ZFERR = 12;
+const int ZCRC = 13;
+const int ZCHALLENGE = 14;
+const int ZCAN = 16;
+
+/// readHeader() results other than a header type
+const int HEADER_TIMEOUT = -1;
+const int HEADER_DAMAGED = -2;
+const int HEADER_CANCELLED = -3;
+
+/// subpacket ends: end of frame, go on, go on and acknowledge, wait for acknowledgement
+const char ZCRCE = 'h';
+const char ZCRCG = 'i';
+const char ZCRCQ = 'j';
+const char ZCRCW = 'k';
+
+/// escaped rubouts
+const int ZRUB0 = 'l';
+const int ZRUB1 = 'm';
+
+/// ZRINIT capabilities: overlapping disk and serial I/O, CRC-32, all control chars escaped
+const unsigned char CANOVIO = 0x02;
+const unsigned char CANFC32 = 0x20;
+const unsigned char ESCCTL = 0x40;
+
+/// ZFILE option: resume an interrupted transfer
+const unsigned char ZCRESUM = 3;
+
+/// consecutive CAN cancelling the session
+const int CANCEL_COUNT = 5;
+
+/// amount of file data in a subpacket
+const int SUBPACKET_SIZE = 1024;
+
+/// bytes queued in the port while streaming, bounds memory use
+const qint64 STREAM_QUEUE = 8 * SUBPACKET_SIZE;
+
+/// time given to the receiver to start
+const int SYNC_TIMEOUT_MS = 60000;
+
+/// interval between two session requests
+const int REINIT_MS = 5000;
+
+/// time to wait for a reply
+const int ACK_TIMEOUT_MS = 10000;
+
+/// time to wait for each byte of a header once it started
+const int HEADER_BYTE_TIMEOUT_MS = 1000;
+
+/// interval between checks of quit_requested while waiting
+const int POLL_MS = 1000;
+
+/// attempts to get a reply
+const int MAX_RETRIES = 10;
+
+/// attempts to end the session, every file has been acknowledged already
+const int FIN_RETRIES = 3;
+
+/**
+ * \brief store a file position in header data
+ */
+static void encodePosition(qint64 pos, unsigned char data[4])
+{
+    data[0] = pos & 0xff;
+    data[1] = (pos >> 8) & 0xff;
+    data[2] = (pos >> 16) & 0xff;
+    data[3] = (pos >> 24) & 0xff;
+}
+
+/**
+ * \brief return the value of a hex digit, -1 if c is not one
+ */
+static int hexValue(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * \brief return the CRC-32 of the first len bytes of a file, of the whole
+ *  file if len is 0
+ */
+static unsigned int fileCrc32(const QString &filename, qint64 len)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    if (len <= 0)
+        len = file.size();
+
+    unsigned int crc = 0;
+    char block[64 * 1024];
+    while (len > 0)
+    {
+        const qint64 count = file.read(block, qMin<qint64>(sizeof(block), len));
+        if (count <= 0)
+            break;
+        crc = crc32_update(crc, block, count);
+        len -= count;
+    }
+    return crc;
+}
+
+ZModemTransfer::ZModemTransfer(QObject *parent, QSerialPort *serial, const QStringList &filenames)
+    : FileTransfer(parent, serial, filenames.value(0), Send),
+      filenames(filenames),
+      window(0),
+      rx_flags(0),
+      rx_buffer(0),
+      use_crc32(false),
+      offset(0),
+      acked(0),
+      last_request(0),
+      frame_ended(true),
+      last_sent(0)
+{
+    quit_requested = false;
+    memset(rx_header, 0, sizeof(rx_header));
+}
+
+void ZModemTransfer::setWindow(int bytes)
+{
+    window = qMax(0, bytes);
+}
+
+void ZModemTransfer::performTransfer()
+{
+    finishTransfer(sendBatch(filenames));
+}
+
+FileTransfer::TransferError ZModemTransfer::beginBatch()
+{
+    const unsigned char zero[4] = { 0, 0, 0, 0 };
+
+    // starts rz if the remote is a shell
+    serial->write("rz\r");
+    sendHexHeader(ZRQINIT, zero);
+
+    QElapsedTimer timer;
+    timer.start();
+    QElapsedTimer last_init;
+    last_init.start();
+
+    while (timer.elapsed() < SYNC_TIMEOUT_MS)
+    {
+        if (quit_requested)
+        {
+            cancel();
+            return LocalCancelledError;
+        }
+
+        switch (readHeader(POLL_MS))
+        {
+            case ZRINIT:
+                rx_flags = rx_header[3];
+                rx_buffer = rx_header[0] | (rx_header[1] << 8);
+                use_crc32 = rx_flags & CANFC32;
+                return NoError;
+            case ZCHALLENGE:
+                sendHexHeader(ZACK, rx_header);
+                break;
+            case HEADER_CANCELLED:
+                return RemoteCancelledError;
+            default:
+                if (last_init.elapsed() >= REINIT_MS)
+                {
+                    sendHexHeader(ZRQINIT, zero);
+                    last_init.restart();
+                }
+                break;
+        }
+    }
+
+    cancel();
+    return NoSyncError;
+}
+
+FileTransfer::TransferError ZModemTransfer::sendBatchFile(const QString &name)
+{
+    // name, then size and octal modification time when known
+    const QFileInfo info(name);
+    QByteArray file_info = info.fileName().toUtf8();
+    file_info.append('\0');
+    if (total_size >= 0)
+    {
+        file_info.append(QByteArray::number(total_size));
+        file_info.append(' ');
+        file_info.append(QByteArray::number(info.lastModified().toMSecsSinceEpoch() / 1000, 8));
+    }
+    file_info.append('\0');
+
+    // the receiver answers with the offset to start from
+    const unsigned char options[4] = { 0, 0, 0, ZCRESUM };
+
+    for (int retry = 0; retry < MAX_RETRIES; ++retry)
+    {
+        if (quit_requested)
+        {
+            cancel();
+            return LocalCancelledError;
+        }
+
+        if (retry > 0)
+            ++stats.retries;
+
+        sendBinaryHeader(ZFILE, options);
+        sendSubpacket(file_info.constData(), file_info.size(), ZCRCW);
+
+        bool resend = false;
+        while (!resend)
+        {
+            const int type = readHeader(ACK_TIMEOUT_MS);
+            switch (type)
+            {
+                case ZRPOS:
+                    offset = headerPosition();
+                    return sendData();
+                case ZSKIP:
+                    return NoError;
+                case ZCRC:
+                {
+                    // the receiver compares with the part it already has
+                    unsigned char crc[4];
+                    encodePosition(fileCrc32(name, headerPosition()), crc);
+                    sendHexHeader(ZCRC, crc);
+                    break;
+                }
+                case ZACK:
+                    // late acknowledgement
+                    break;
+                case HEADER_CANCELLED:
+                case ZABORT:
+                case ZFERR:
+                case ZCAN:
+                    return RemoteCancelledError;
+                default:
+                    // ZRINIT, ZNAK, damaged header or timeout
+                    resend = true;
+                    break;
+            }
+        }
+    }
+
+    cancel();
+    return TransmissionError;
+}
+
+FileTransfer::TransferError ZModemTransfer::sendData()
+{
+    if (!source.seek(offset))
+    {
+        cancel();
+        return InputFileError;
+    }
+
+    const qint64 start = offset;
+    acked = offset;
+    last_request = offset;
+    frame_ended = true;
+
+    char block[SUBPACKET_SIZE];
+    unsigned char pos[4];
+    int timeouts = 0;
+    TransferError error;
+
+    forever
+    {
+        if (quit_requested)
+        {
+            cancel();
+            return LocalCancelledError;
+        }
+
+        if (frame_ended)
+        {
+            encodePosition(offset, pos);
+            sendBinaryHeader(ZDATA, pos);
+            frame_ended = false;
+        }
+
+        const int len = source.read(block, SUBPACKET_SIZE);
+        if (len < 0)
+        {
+            cancel();
+            return InputFileError;
+        }
+
+        if (len == 0)
+        {
+            // end the frame, then tell where the file ends
+            sendSubpacket(block, 0, ZCRCE);
+            frame_ended = true;
+            encodePosition(offset, pos);
+            sendBinaryHeader(ZEOF, pos);
+
+            int type;
+            do
+            {
+                if (quit_requested)
+                {
+                    cancel();
+                    return LocalCancelledError;
+                }
+
+                type = readHeader(ACK_TIMEOUT_MS);
+                if (type == ZRINIT)
+                {
+                    // the whole file made it, acknowledgement requests included
+                    blockReplied(BlockAcked);
+                    stats.bytes += qMax<qint64>(0, offset - start);
+                    return NoError;
+                }
+
+                if (type == HEADER_TIMEOUT)
+                {
+                    blockReplied(BlockTimedOut);
+                    if (++timeouts >= MAX_RETRIES)
+                    {
+                        cancel();
+                        return TimeoutError;
+                    }
+                    ++stats.retries;
+                    sendBinaryHeader(ZEOF, pos);
+                    continue;
+                }
+
+                error = handleDataReply(type);
+                if (error != NoError)
+                    return error;
+            }
+            while (type != ZRPOS);
+
+            // data again, from the requested position
+            continue;
+        }
+
+        offset += len;
+
+        // a receiver that can't write while receiving gets at most a
+        // buffer, then a subpacket waiting for its acknowledgement
+        char end = ZCRCG;
+        if (!(rx_flags & CANOVIO) || (rx_buffer > 0 && offset - acked >= rx_buffer))
+        {
+            end = ZCRCW;
+        }
+        else if (window > 0 && offset - last_request >= qMax(window / 4, 1))
+        {
+            end = ZCRCQ;
+            last_request = offset;
+        }
+
+        sendSubpacket(block, len, end);
+        blockSent(offset - len, len, end != ZCRCG);
+        reportProgress(offset);
+
+        if (end == ZCRCW)
+        {
+            frame_ended = true;
+
+            int type = HEADER_TIMEOUT;
+            while (type != ZACK && type != ZRPOS)
+            {
+                type = readHeader(ACK_TIMEOUT_MS);
+                if (type == HEADER_TIMEOUT)
+                {
+                    blockReplied(BlockTimedOut);
+                    if (++timeouts >= MAX_RETRIES)
+                    {
+                        cancel();
+                        return TimeoutError;
+                    }
+                    ++stats.retries;
+                    type = ZRPOS;
+                    error = reposition(acked);
+                }
+                else
+                {
+                    error = handleDataReply(type);
+                }
+
+                if (error != NoError)
+                    return error;
+            }
+            timeouts = 0;
+            continue;
+        }
+
+        if (!drainOutput(STREAM_QUEUE))
+        {
+            cancel();
+            return TimeoutError;
+        }
+
+        // while streaming, the receiver only talks to acknowledge or to ask
+        // for a retransmission
+        int type;
+        while ((type = readHeader(0)) != HEADER_TIMEOUT)
+        {
+            error = handleDataReply(type);
+            if (error != NoError)
+                return error;
+        }
+
+        // don't get more than a window ahead of the receiver
+        while (window > 0 && offset - acked >= window)
+        {
+            if (quit_requested)
+            {
+                cancel();
+                return LocalCancelledError;
+            }
+
+            type = readHeader(ACK_TIMEOUT_MS);
+            if (type == HEADER_TIMEOUT)
+            {
+                blockReplied(BlockTimedOut);
+                if (++timeouts >= MAX_RETRIES)
+                {
+                    cancel();
+                    return TimeoutError;
+                }
+
+                // the acknowledgement request was lost, start over from the last one
+                ++stats.retries;
+                error = reposition(acked);
+            }
+            else
+            {
+                timeouts = 0;
+                error = handleDataReply(type);
+            }
+
+            if (error != NoError)
+                return error;
+        }
+    }
+}
+
+FileTransfer::TransferError ZModemTransfer::endBatch()
+{
+    const unsigned char zero[4] = { 0, 0, 0, 0 };
+
+    for (int retry = 0; retry < FIN_RETRIES; ++retry)
+    {
+        sendHexHeader(ZFIN, zero);
+
+        int type;
+        do
+        {
+            type = readHeader(ACK_TIMEOUT_MS);
+            if (type == ZFIN)
+            {
+                // over and out
+                serial->write("OO");
+                drainOutput(0);
+                return NoError;
+            }
+            if (type == HEADER_CANCELLED)
+                return RemoteCancelledError;
+        }
+        while (type != HEADER_TIMEOUT);
+    }
+
+    // all files were received, only the goodbye got lost
+    return NoError;
+}
+
+FileTransfer::TransferError ZModemTransfer::handleDataReply(int type)
+{
+    switch (type)
+    {
+        case ZACK:
+            acked = qMax(acked, headerPosition());
+            blockReplied(BlockAcked, headerPosition());
+            return NoError;
+        case ZRPOS:
+            // damaged data or lost subpacket
+            ++stats.retries;
+            blockReplied(BlockRejected);
+            return reposition(headerPosition());
+        case HEADER_CANCELLED:
+        case ZABORT:
+        case ZFERR:
+        case ZCAN:
+            blockReplied(BlockCancelled);
+            return RemoteCancelledError;
+        default:
+            return NoError;
+    }
+}
+
+FileTransfer::TransferError ZModemTransfer::reposition(qint64 pos)
+{
+    // data still queued is past the position, drop it
+    serial->clear(QSerialPort::Output);
+
+    if (!source.seek(pos))
+    {
+        cancel();
+        return InputFileError;
+    }
+
+    offset = pos;
+    acked = pos;
+    last_request = pos;
+    frame_ended = true;
+    return NoError;
+}
+
+int ZModemTransfer::readHeader(int timeout_ms)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int cans = 0;
+
+    forever
+    {
+        int c = input.getByte(qMax<qint64>(0, timeout_ms - timer.elapsed()));
+        if (c < 0)
+            return HEADER_TIMEOUT;
+
+        // ZDLE is also CAN
+        if (c == ZDLE)
+        {
+            if (++cans >= CANCEL_COUNT)
+                return HEADER_CANCELLED;
+            continue;
+        }
+        cans = 0;
+
+        // skip anything else than a header: XON, CR LF, garbage
+        if (c != ZPAD)
+            continue;
+
+        do
+            c = input.getByte(HEADER_BYTE_TIMEOUT_MS);
+        while (c == ZPAD);
+
+        if (c != ZDLE)
+            continue;
+
+        switch (input.getByte(HEADER_BYTE_TIMEOUT_MS))
+        {
+            case ZHEX:
+                return readHexHeader();
+            case ZBIN:
+                return readBinaryHeader(false);
+            case ZBIN32:
+                return readBinaryHeader(true);
+            default:
+                return HEADER_DAMAGED;
+        }
+    }
+}
+
+int ZModemTransfer::readHexHeader()
+{
+    // type, data and CRC-16, two hex digits per byte
+    unsigned char raw[7];
+    for (int i = 0; i < 7; ++i)
+    {
+        const int high = hexValue(input.getByte(HEADER_BYTE_TIMEOUT_MS));
+        const int low = hexValue(input.getByte(HEADER_BYTE_TIMEOUT_MS));
+        if (high < 0 || low < 0)
+            return HEADER_DAMAGED;
+        raw[i] = (high << 4) | low;
+    }
+
+    if (crc16_ccitt(raw, 5) != ((raw[5] << 8) | raw[6]))
+        return HEADER_DAMAGED;
+
+    memcpy(rx_header, raw + 1, 4);
+    return raw[0];
+}
+
+int ZModemTransfer::readBinaryHeader(bool crc32)
+{
+    // type, data and CRC
+    unsigned char raw[9];
+    const int len = crc32 ? 9 : 7;
+    for (int i = 0; i < len; ++i)
+    {
+        const int c = readEscaped();
+        if (c < 0)
+            return HEADER_DAMAGED;
+        raw[i] = c;
+    }
+
+    if (crc32)
+    {
+        const unsigned int crc = raw[5] | (raw[6] << 8) | (raw[7] << 16) | ((unsigned int)raw[8] << 24);
+        if (crc32_update(0, raw, 5) != crc)
+            return HEADER_DAMAGED;
+    }
+    else if (crc16_ccitt(raw, 5) != ((raw[5] << 8) | raw[6]))
+    {
+        return HEADER_DAMAGED;
+    }
+
+    memcpy(rx_header, raw + 1, 4);
+    return raw[0];
+}
+
+int ZModemTransfer::readEscaped()
+{
+    forever
+    {
+        int c = input.getByte(HEADER_BYTE_TIMEOUT_MS);
+
+        switch (c)
+        {
+            case 0x11:
+            case 0x13:
+            case 0x91:
+            case 0x93:
+                // flow control, not data
+                continue;
+            case ZDLE:
+                c = input.getByte(HEADER_BYTE_TIMEOUT_MS);
+                if (c < 0)
+                    return -1;
+                if (c == ZRUB0)
+                    return 0x7f;
+                if (c == ZRUB1)
+                    return 0xff;
+                return c ^ 0x40;
+            default:
+                return c;
+        }
+    }
+}
+
+void ZModemTransfer::sendHexHeader(int type, const unsigned char data[4])
+{
+    const unsigned char raw[5] = { (unsigned char)type, data[0], data[1], data[2], data[3] };
+    const unsigned short crc = crc16_ccitt(raw, 5);
+    const char crc_bytes[2] = { char(crc >> 8), char(crc & 0xff) };
+
+    QByteArray header;
+    header.append(ZPAD);
+    header.append(ZPAD);
+    header.append(ZDLE);
+    header.append(ZHEX);
+    header.append(QByteArray(reinterpret_cast<const char *>(raw), 5).toHex());
+    header.append(QByteArray(crc_bytes, 2).toHex());
+    header.append("\r\x8a");
+
+    // the receiver may have been stopped by a spurious XOFF
+    if (type != ZFIN && type != ZACK)
+        header.append(XON);
+
+    serial->write(header);
+    serial->flush();
+}
+
+void ZModemTransfer::sendBinaryHeader(int type, const unsigned char data[4])
+{
+    const unsigned char raw[5] = { (unsigned char)type, data[0], data[1], data[2], data[3] };
+
+    QByteArray header;
+    header.append(ZPAD);
+    header.append(ZDLE);
+    header.append(use_crc32 ? ZBIN32 : ZBIN);
+    appendEscaped(&header, reinterpret_cast<const char *>(raw), 5);
+
+    if (use_crc32)
+    {
+        const unsigned int crc = crc32_update(0, raw, 5);
+        const char crc_bytes[4] = { char(crc & 0xff), char((crc >> 8) & 0xff),
+                                    char((crc >> 16) & 0xff), char(crc >> 24) };
+        appendEscaped(&header, crc_bytes, 4);
+    }
+    else
+    {
+        const unsigned short crc = crc16_ccitt(raw, 5);
+        const char crc_bytes[2] = { char(crc >> 8), char(crc & 0xff) };
+        appendEscaped(&header, crc_bytes, 2);
+    }
+
+    serial->write(header);
+    serial->flush();
+}
+
+void ZModemTransfer::sendSubpacket(const char *data, int len, char end)
+{
+    QByteArray packet;
+    packet.reserve(len + len / 8 + 16);
+    appendEscaped(&packet, data, len);
+    packet.append(ZDLE);
+    packet.append(end);
+    last_sent = end;
+
+    // the CRC covers the frame end too
+    if (use_crc32)
+    {
+        const unsigned int crc = crc32_update(crc32_update(0, data, len), &end, 1);
+        const char crc_bytes[4] = { char(crc & 0xff), char((crc >> 8) & 0xff),
+                                    char((crc >> 16) & 0xff), char(crc >> 24) };
+        appendEscaped(&packet, crc_bytes, 4);
+    }
+    else
+    {
+        const unsigned short crc = crc16_ccitt_update(crc16_ccitt_update(0, data, len), &end, 1);
+        const char crc_bytes[2] = { char(crc >> 8), char(crc & 0xff) };
+        appendEscaped(&packet, crc_bytes, 2);
+    }
+
+    if (end == ZCRCW)
+        packet.append(XON);
+
+    serial->write(packet);
+    serial->flush();
+}
+
+void ZModemTransfer::appendEscaped(QByteArray *out, const char *data, int len)
+{
+    for (int i = 0; i < len; ++i)
+    {
+        unsigned char c = data[i];
+
+        bool escape;
+        switch (c)
+        {
+            case ZDLE:
+            case 0x10:
+            case 0x11:
+            case 0x13:
+            case 0x90:
+            case 0x91:
+            case 0x93:
+            case 0x98:
+                escape = true;
+                break;
+            case '\r':
+            case 0x8d:
+                // "@\r" would be taken for a Telenet escape
+                escape = (last_sent & 0x7f) == '@';
+                break;
+            default:
+                escape = (rx_flags & ESCCTL) && (c & 0x60) == 0;
+                break;
+        }
+
+        if (escape)
+        {
+            out->append(ZDLE);
+            c ^= 0x40;
+        }
+        out->append(char(c));
+        last_sent = c;
+    }
+}
+
+qint64 ZModemTransfer::headerPosition() const
+{
+    return rx_header[0] | (rx_header[1] << 8) | (rx_header[2] << 16) |
+            (qint64(rx_header[3]) << 24);
+}
+
+void ZModemTransfer::cancel()
+{
+    if (serial->isOpen())
+    {
+        // cancel sequence, then erase it from a terminal
+        serial->write(QByteArray(8, ZDLE) + QByteArray(8, '\b'));
+        serial->flush();
+    }
+}
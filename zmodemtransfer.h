@@ -0,0 +1,193 @@
+/**
+ * \file
+ * <!--
+ * Copyright 2015 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief ZModemTransfer class header
+ *
+ * \author Aurelien Rainone <aurelien@develer.com>
+ */
+
+#ifndef ZMODEMTRANSFER_H
+#define ZMODEMTRANSFER_H
+
+#include <QStringList>
+
+#include "filetransfer.h"
+
+/**
+ * \brief send a batch of files over ZMODEM
+ *
+ * file data is streamed in ZDLE-escaped subpackets protected by a CRC-32
+ * (CRC-16 if the receiver can't check a CRC-32), without waiting for
+ * acknowledgements. With a window, the sender asks for an acknowledgement
+ * every quarter of the window and never gets more than a window ahead of
+ * the last one.
+ *
+ * the receiver tells where to start or restart with ZRPOS: after a damaged
+ * subpacket, or when it already holds the beginning of the file, since
+ * files are offered for resume. An interrupted transfer thus continues
+ * where it stopped when the same file is sent again.
+ *
+ * \note positions are 32 bits wide on the wire, as in all ZMODEM
+ *  implementations, so files are limited to 4 GiB
+ */
+class ZModemTransfer : public FileTransfer
+{
+    Q_OBJECT
+
+private:
+
+    /// files to send, in order
+    QStringList   filenames;
+
+    /// bytes sent ahead of the last acknowledgement, 0 for no limit
+    int           window;
+
+    /// receiver capabilities, see ZRINIT flags
+    unsigned char rx_flags;
+
+    /// receiver buffer size, 0 if it can receive while writing to disk
+    int           rx_buffer;
+
+    /// data subpackets are protected by a CRC-32
+    bool          use_crc32;
+
+    /// data of the last received header
+    unsigned char rx_header[4];
+
+    /// offset of the next byte to send in current file
+    qint64        offset;
+
+    /// last offset acknowledged by the receiver
+    qint64        acked;
+
+    /// offset of the last acknowledgement request
+    qint64        last_request;
+
+    /// set once a new ZDATA header is needed before sending data
+    bool          frame_ended;
+
+    /// last byte sent, a CR following '@' is escaped
+    unsigned char last_sent;
+
+public:
+
+    /**
+     * \brief create a ZModem transfer thread
+     * \param parent    object taking ownership
+     * \param serial    opened instance of QSerialPort
+     * \param filenames files to send, at least one
+     */
+    ZModemTransfer(QObject *parent, QSerialPort *serial, const QStringList &filenames);
+
+    /**
+     * \brief limit the amount of data sent ahead of the receiver
+     * \param bytes window size, 0 to stream whole files without waiting
+     *  (default)
+     * \note must be called before startTransfer()
+     */
+    void setWindow(int bytes);
+
+private:
+
+    /**
+     * \brief send the batch, the first file is already open
+     */
+    void performTransfer();
+
+    /**
+     * \brief wake the receiver up and read its capabilities
+     */
+    TransferError beginBatch();
+
+    /**
+     * \brief offer the file in source, then send it from where the
+     *  receiver asks for
+     * \param name file name
+     */
+    TransferError sendBatchFile(const QString &name);
+
+    /**
+     * \brief send the content of source, from offset to the end
+     */
+    TransferError sendData();
+
+    /**
+     * \brief end the batch
+     */
+    TransferError endBatch();
+
+    /**
+     * \brief act on a header received while sending data
+     * \param type header type, or a negative readHeader() result
+     * \return NoError to go on sending
+     */
+    TransferError handleDataReply(int type);
+
+    /**
+     * \brief restart sending data from given offset
+     */
+    TransferError reposition(qint64 pos);
+
+    /**
+     * \brief wait for a header from the receiver, skipping anything else
+     * \param timeout_ms time to wait for the first byte of a header
+     * \return header type, data in rx_header, or a negative value on
+     *  timeout, damaged header or cancellation
+     */
+    int readHeader(int timeout_ms);
+
+    /**
+     * \brief read the rest of a hex header
+     */
+    int readHexHeader();
+
+    /**
+     * \brief read the rest of a binary header
+     * \param crc32 header protected by a CRC-32 rather than a CRC-16
+     */
+    int readBinaryHeader(bool crc32);
+
+    /**
+     * \brief read a ZDLE-escaped byte
+     * \return byte, or -1 on timeout
+     */
+    int readEscaped();
+
+    /**
+     * \brief send a hex header
+     */
+    void sendHexHeader(int type, const unsigned char data[4]);
+
+    /**
+     * \brief send a binary header, with a CRC-32 if the receiver supports it
+     */
+    void sendBinaryHeader(int type, const unsigned char data[4]);
+
+    /**
+     * \brief send a data subpacket
+     * \param data  subpacket data
+     * \param len   data length
+     * \param end   frame end: ZCRCE, ZCRCG, ZCRCQ or ZCRCW
+     */
+    void sendSubpacket(const char *data, int len, char end);
+
+    /**
+     * \brief append ZDLE-escaped data to out
+     */
+    void appendEscaped(QByteArray *out, const char *data, int len);
+
+    /**
+     * \brief return the position held by the last received header
+     */
+    qint64 headerPosition() const;
+
+    /**
+     * \brief abort the transfer on the receiver side
+     */
+    void cancel();
+};
+
+#endif // ZMODEMTRANSFER_H